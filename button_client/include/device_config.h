@@ -3,21 +3,26 @@
 
 #include <zephyr/bluetooth/mesh.h>
 #include "vendor_model.h"
+#include "health.h"
 
 /* Device UUID for provisioning */
 #define DEV_UUID { 0xcc, 0xcc }
 
-/* Health Server */
-#define HEALTH_SRV_CB { \
-    .attn_on = NULL, \
-    .attn_off = NULL, \
-}
+/* UUID prefix advertised by light server nodes */
+#define LIGHT_SERVER_UUID_PREFIX { 0xdd, 0xdd }
 
-#define HEALTH_PUB { \
-    .msg = NULL, \
+/* Health Server, attention callbacks live in main.c */
+#define HEALTH_SRV_CB { \
+    .fault_get_cur = health_fault_get_cur, \
+    .fault_get_reg = health_fault_get_reg, \
+    .fault_clear = health_fault_clear, \
+    .fault_test = health_fault_test, \
+    .attn_on = attention_on, \
+    .attn_off = attention_off, \
 }
 
 /* Model Operation Arrays */
 extern const struct bt_mesh_model_op vendor_cli_op[];
+extern const struct bt_mesh_model_cb vendor_cli_cb;
 
 #endif /* DEVICE_CONFIG_H */
@@ -0,0 +1,35 @@
+#ifndef LOADGEN_H
+#define LOADGEN_H
+
+#include <zephyr/bluetooth/mesh.h>
+#include "vendor_model.h"
+
+enum loadgen_op {
+    LOADGEN_OP_SET,
+    LOADGEN_OP_GET,
+    LOADGEN_OP_PROBE,   /* Button Press, no response expected */
+    LOADGEN_OP_COUNT,
+};
+
+/* Limits checked by loadgen_start() */
+#define LOADGEN_RATE_MAX        1000    /* Messages per second */
+#define LOADGEN_DURATION_MAX_S  3600
+
+struct loadgen_params {
+    uint32_t rate;                          /* Messages per second */
+    uint32_t duration_s;
+    uint8_t mix[LOADGEN_OP_COUNT];          /* Relative weights per op */
+    uint16_t dst[CONFIG_BUTTON_CLIENT_LOADGEN_MAX_DST];
+    uint8_t dst_count;                      /* Used round-robin */
+};
+
+void loadgen_init(struct bt_mesh_vendor_model_cli *cli);
+int loadgen_start(const struct loadgen_params *params);
+void loadgen_stop(void);
+void loadgen_summary_print(void);
+
+/* Feed LED Status messages received by the client */
+void loadgen_status_received(struct bt_mesh_msg_ctx *ctx,
+                             struct led_status *status);
+
+#endif /* LOADGEN_H */
@@ -0,0 +1,19 @@
+#ifndef PROVISIONER_H
+#define PROVISIONER_H
+
+#include <zephyr/bluetooth/mesh.h>
+
+/* Create (or load) the CDB, provision this node and start the
+ * provisioning and configuration pipeline.
+ */
+int provisioner_start(void);
+
+/* Provisioning callbacks, hooked into the node's bt_mesh_prov */
+void provisioner_unprovisioned_beacon(uint8_t uuid[16],
+                                      bt_mesh_prov_oob_info_t oob_info,
+                                      uint32_t *uri_hash);
+void provisioner_node_added(uint16_t net_idx, uint8_t uuid[16],
+                            uint16_t addr, uint8_t num_elem);
+void provisioner_link_close(bt_mesh_prov_bearer_t bearer);
+
+#endif /* PROVISIONER_H */
@@ -1,22 +1,29 @@
 #ifndef VENDOR_MODEL_H
 #define VENDOR_MODEL_H
 
+#include <zephyr/kernel.h>
 #include <zephyr/bluetooth/mesh.h>
+#include "vendor_model_work.h"
 
 #define BT_MESH_VENDOR_COMPANY_ID    0x0059  /* Nordic Semiconductor ASA */
-#define BT_MESH_VENDOR_MODEL_ID_CLI  0x000A
-#define BT_MESH_VENDOR_MODEL_ID_SRV  0x000B
+#define BT_MESH_VENDOR_MODEL_ID_CLI  0x0001
+#define BT_MESH_VENDOR_MODEL_ID_SRV  0x0000
 
-#define BT_MESH_VENDOR_OP_LED_SET       BT_MESH_MODEL_OP_3(0x01, BT_MESH_VENDOR_COMPANY_ID)
-#define BT_MESH_VENDOR_OP_LED_GET       BT_MESH_MODEL_OP_3(0x02, BT_MESH_VENDOR_COMPANY_ID)
-#define BT_MESH_VENDOR_OP_LED_STATUS    BT_MESH_MODEL_OP_3(0x03, BT_MESH_VENDOR_COMPANY_ID)
-#define BT_MESH_VENDOR_OP_BUTTON_PRESS  BT_MESH_MODEL_OP_3(0x04, BT_MESH_VENDOR_COMPANY_ID)
+#define BT_MESH_VENDOR_OP_LED_SET       BT_MESH_MODEL_OP_3(0x00, BT_MESH_VENDOR_COMPANY_ID)
+#define BT_MESH_VENDOR_OP_LED_GET       BT_MESH_MODEL_OP_3(0x01, BT_MESH_VENDOR_COMPANY_ID)
+#define BT_MESH_VENDOR_OP_LED_STATUS    BT_MESH_MODEL_OP_3(0x02, BT_MESH_VENDOR_COMPANY_ID)
+#define BT_MESH_VENDOR_OP_BUTTON_PRESS  BT_MESH_MODEL_OP_3(0x03, BT_MESH_VENDOR_COMPANY_ID)
+#define BT_MESH_VENDOR_OP_TIME_BEACON   BT_MESH_MODEL_OP_3(0x04, BT_MESH_VENDOR_COMPANY_ID)
+#define BT_MESH_VENDOR_OP_LED_SET_AT    BT_MESH_MODEL_OP_3(0x05, BT_MESH_VENDOR_COMPANY_ID)
 
 #define BT_MESH_VENDOR_MSG_MAXLEN_MESSAGE 32
 
 #define LED_OFF 0x00
 #define LED_ON  0x01
 
+#define BUTTON_PRESSED  0x01
+#define BUTTON_RELEASED 0x00
+
 struct led_status {
     uint8_t led_index;
     uint8_t led_state;
@@ -27,6 +34,17 @@ struct button_press {
     uint8_t button_state;
 };
 
+/* Time beacon, sent by the client as the network time reference. The
+ * reference time is the client's uptime in microseconds. The beacon
+ * carries the time at which the previous beacon actually went on air,
+ * so receivers can pair it with the time they received that beacon.
+ */
+struct time_beacon {
+    uint8_t seq;
+    uint8_t ttl;            /* TTL the beacon was sent with */
+    uint32_t prev_tx_us;    /* TX time of beacon seq - 1, 0 if unknown */
+};
+
 struct bt_mesh_vendor_model_srv;
 struct bt_mesh_vendor_model_cli;
 
@@ -51,6 +69,13 @@ struct vendor_model_cli_handlers {
                            struct led_status *status);
 };
 
+/* Console messages from the vendor model handlers */
+#if defined(CONFIG_VENDOR_MODEL_LOG)
+#define VENDOR_MODEL_PRINTK(...) printk(__VA_ARGS__)
+#else
+#define VENDOR_MODEL_PRINTK(...)
+#endif
+
 /* Server model context */
 struct bt_mesh_vendor_model_srv {
     struct bt_mesh_model *model;
@@ -58,10 +83,36 @@ struct bt_mesh_vendor_model_srv {
     uint8_t led_states[4];
 };
 
+/* Outgoing command waiting for an advertising buffer. There is at most one
+ * per (opcode, destination, LED); a newer command of the same kind for the
+ * same target replaces it.
+ */
+struct bt_mesh_vendor_model_cli_slot {
+    uint32_t opcode;
+    uint32_t seq;       /* Drain order */
+    uint16_t addr;
+    uint8_t led_index;
+    uint8_t value;
+    bool pending;
+};
+
 /* Client model context */
 struct bt_mesh_vendor_model_cli {
-    struct bt_mesh_model *model;
+    const struct bt_mesh_model *model;
     const struct vendor_model_cli_handlers handlers;
+    struct bt_mesh_vendor_model_cli_slot slots[CONFIG_VENDOR_MODEL_CLI_SLOT_COUNT];
+    struct k_mutex slot_lock;
+    struct vendor_model_work drain_work;
+    struct k_timer retry_timer;
+    uint32_t seq;
+    uint32_t pending_count;
+    uint32_t coalesced;     /* Commands superseded before they were sent */
+    uint8_t beacon_seq;
+    uint32_t beacon_tx_us;
+#if defined(CONFIG_VENDOR_MODEL_NET_TIME)
+    struct vendor_model_work beacon_work;
+    struct k_timer beacon_timer;
+#endif
 };
 
 /* Server API */
@@ -69,15 +120,43 @@ int bt_mesh_vendor_model_srv_led_status_send(struct bt_mesh_vendor_model_srv *sr
                                           struct bt_mesh_msg_ctx *ctx,
                                           struct led_status *status);
 
-/* Client API */
+/* Client API, addr is the destination (unicast, group or
+ * BT_MESH_ADDR_ALL_NODES). LED Set and Button Press are latest-wins: when
+ * no advertising buffer is free they are held in the slot table and sent
+ * once buffers free up. They return -EINPROGRESS when the command was
+ * held, -EALREADY when it replaced a held one, and -ENOBUFS only when the
+ * table is full.
+ */
 int bt_mesh_vendor_model_cli_led_set(struct bt_mesh_vendor_model_cli *cli,
+                                   uint16_t addr,
                                    uint8_t led_index,
                                    uint8_t led_state);
 int bt_mesh_vendor_model_cli_led_get(struct bt_mesh_vendor_model_cli *cli,
+                                   uint16_t addr,
                                    uint8_t led_index);
 int bt_mesh_vendor_model_cli_button_press(struct bt_mesh_vendor_model_cli *cli,
+                                        uint16_t addr,
                                         struct button_press *press);
 
+/* Held commands replaced by a newer one for the same target since boot */
+uint32_t bt_mesh_vendor_model_cli_coalesced_get(struct bt_mesh_vendor_model_cli *cli);
+
+#if defined(CONFIG_VENDOR_MODEL_NET_TIME)
+/* LED Set executed by every receiver at the same network time, delay_us
+ * from now. Sent directly, -ENOBUFS is returned when no buffer is free.
+ */
+int bt_mesh_vendor_model_cli_led_set_at(struct bt_mesh_vendor_model_cli *cli,
+                                      uint16_t addr,
+                                      uint8_t led_index,
+                                      uint8_t led_state,
+                                      uint32_t delay_us);
+int bt_mesh_vendor_model_cli_time_beacon_send(struct bt_mesh_vendor_model_cli *cli,
+                                            uint16_t addr);
+
+/* Network time reference, in microseconds */
+uint32_t vendor_model_net_time_us(void);
+#endif
+
 /* Model Definitions */
 #define BT_MESH_VENDOR_MODEL_SRV_DEFINE(_name, _handlers) \
     static struct bt_mesh_vendor_model_srv _name = { \
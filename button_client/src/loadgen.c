@@ -0,0 +1,543 @@
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/mesh.h>
+#include <zephyr/random/random.h>
+#include <zephyr/shell/shell.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vendor_model.h"
+#include "loadgen.h"
+
+#define MAX_PENDING CONFIG_BUTTON_CLIENT_LOADGEN_MAX_PENDING
+#define MAX_SAMPLES CONFIG_BUTTON_CLIENT_LOADGEN_MAX_SAMPLES
+#define RSP_TIMEOUT_MS CONFIG_BUTTON_CLIENT_LOADGEN_RSP_TIMEOUT
+#define MAX_REPLIERS CONFIG_BUTTON_CLIENT_LOADGEN_MAX_REPLIERS
+
+/* Request waiting for its LED Status */
+struct pending_req {
+    int64_t sent;       /* Uptime in ticks */
+    uint16_t dst;
+    uint16_t repliers[MAX_REPLIERS];    /* Nodes that answered a group request */
+    uint8_t reply_count;
+    uint8_t led_index;
+    bool answered;
+    bool used;
+};
+
+/* A run goes IDLE -> STARTING -> RUNNING -> DRAINING -> IDLE. Only
+ * loadgen_start() leaves IDLE; everything after that, including the
+ * reset of the counters, is done by the load generator thread.
+ */
+enum loadgen_state {
+    LOADGEN_IDLE,
+    LOADGEN_STARTING,
+    LOADGEN_RUNNING,
+    LOADGEN_DRAINING,   /* Sending stopped, still collecting responses */
+};
+
+static atomic_t lg_state = ATOMIC_INIT(LOADGEN_IDLE);
+
+static struct {
+    struct bt_mesh_vendor_model_cli *cli;
+    struct loadgen_params params;
+    int64_t start;
+    int64_t end;
+    uint32_t offered[LOADGEN_OP_COUNT];
+    uint32_t sent;
+    uint32_t enobufs;
+    uint32_t send_err;
+    uint32_t held;          /* Waiting in the client for a buffer */
+    uint32_t coalesced;     /* Replaced a command that was still held */
+    uint32_t requests;      /* Sent messages that expect a response */
+    uint32_t delivered;     /* Requests answered at least once */
+    uint32_t responses;     /* Every matching LED Status */
+    uint32_t timeouts;
+    uint32_t sample_count;
+    uint32_t samples[MAX_SAMPLES];  /* Latency in us */
+    struct pending_req pending[MAX_PENDING];
+} lg;
+
+static struct k_spinlock lg_lock;
+static K_SEM_DEFINE(run_sem, 0, 1);
+
+static enum loadgen_op pick_op(void)
+{
+    uint32_t total = 0;
+    uint32_t r;
+
+    for (int i = 0; i < LOADGEN_OP_COUNT; i++) {
+        total += lg.params.mix[i];
+    }
+
+    r = sys_rand32_get() % total;
+    for (int i = 0; i < LOADGEN_OP_COUNT; i++) {
+        if (r < lg.params.mix[i]) {
+            return i;
+        }
+        r -= lg.params.mix[i];
+    }
+
+    return LOADGEN_OP_SET;
+}
+
+static void pending_add(int64_t now, uint16_t dst, uint8_t led_index)
+{
+    struct pending_req *slot = &lg.pending[0];
+
+    /* Take a free slot, or evict the oldest request */
+    for (int i = 0; i < MAX_PENDING; i++) {
+        if (!lg.pending[i].used) {
+            slot = &lg.pending[i];
+            break;
+        }
+        if (lg.pending[i].sent < slot->sent) {
+            slot = &lg.pending[i];
+        }
+    }
+
+    if (slot->used && !slot->answered) {
+        lg.timeouts++;
+    }
+
+    slot->sent = now;
+    slot->dst = dst;
+    slot->led_index = led_index;
+    slot->reply_count = 0;
+    slot->answered = false;
+    slot->used = true;
+}
+
+static bool pending_replied(const struct pending_req *req, uint16_t addr)
+{
+    for (int i = 0; i < req->reply_count; i++) {
+        if (req->repliers[i] == addr) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void pending_expire(int64_t now, bool all)
+{
+    int64_t timeout = k_ms_to_ticks_ceil64(RSP_TIMEOUT_MS);
+    k_spinlock_key_t key = k_spin_lock(&lg_lock);
+
+    for (int i = 0; i < MAX_PENDING; i++) {
+        struct pending_req *req = &lg.pending[i];
+
+        if (!req->used || (!all && now - req->sent < timeout)) {
+            continue;
+        }
+
+        if (!req->answered) {
+            lg.timeouts++;
+        }
+        req->used = false;
+    }
+
+    k_spin_unlock(&lg_lock, key);
+}
+
+static void send_one(uint32_t n)
+{
+    uint16_t dst = lg.params.dst[n % lg.params.dst_count];
+    uint8_t led_index = (n / lg.params.dst_count) % 4;
+    enum loadgen_op op = pick_op();
+    int64_t now = k_uptime_ticks();
+    k_spinlock_key_t key;
+    int err;
+
+    switch (op) {
+    case LOADGEN_OP_SET:
+        err = bt_mesh_vendor_model_cli_led_set(lg.cli, dst, led_index,
+                                               (n / 4) & 1 ? LED_ON : LED_OFF);
+        break;
+    case LOADGEN_OP_GET:
+        err = bt_mesh_vendor_model_cli_led_get(lg.cli, dst, led_index);
+        break;
+    default: {
+        struct button_press press = {
+            .button_index = led_index,
+            .button_state = BUTTON_PRESSED,
+        };
+
+        err = bt_mesh_vendor_model_cli_button_press(lg.cli, dst, &press);
+        break;
+    }
+    }
+
+    key = k_spin_lock(&lg_lock);
+    lg.offered[op]++;
+    if (!err || err == -EINPROGRESS) {
+        /* A held command still goes out, its latency includes the hold */
+        if (err) {
+            lg.held++;
+        } else {
+            lg.sent++;
+        }
+        if (op != LOADGEN_OP_PROBE) {
+            lg.requests++;
+            pending_add(now, dst, led_index);
+        }
+    } else if (err == -EALREADY) {
+        /* The request already pending for this target covers it */
+        lg.coalesced++;
+    } else if (err == -ENOBUFS) {
+        lg.enobufs++;
+    } else {
+        lg.send_err++;
+    }
+    k_spin_unlock(&lg_lock, key);
+}
+
+void loadgen_status_received(struct bt_mesh_msg_ctx *ctx,
+                             struct led_status *status)
+{
+    struct pending_req *req = NULL;
+    int64_t now = k_uptime_ticks();
+    k_spinlock_key_t key;
+    atomic_val_t state = atomic_get(&lg_state);
+
+    if (state != LOADGEN_RUNNING && state != LOADGEN_DRAINING) {
+        return;
+    }
+
+    key = k_spin_lock(&lg_lock);
+    lg.responses++;
+
+    /* Match the oldest request this node has not answered yet. A group
+     * request stays matchable after its first reply, so the other nodes'
+     * replies land on it rather than on a later request for the same LED.
+     */
+    for (int i = 0; i < MAX_PENDING; i++) {
+        struct pending_req *p = &lg.pending[i];
+
+        if (!p->used || p->led_index != status->led_index) {
+            continue;
+        }
+        if (BT_MESH_ADDR_IS_UNICAST(p->dst) && p->dst != ctx->addr) {
+            continue;
+        }
+        if (pending_replied(p, ctx->addr)) {
+            continue;
+        }
+        if (!req || p->sent < req->sent) {
+            req = p;
+        }
+    }
+
+    if (req) {
+        /* Delivery and latency are taken from the first reply only */
+        if (!req->answered) {
+            req->answered = true;
+            lg.delivered++;
+            if (lg.sample_count < MAX_SAMPLES) {
+                lg.samples[lg.sample_count++] =
+                    k_ticks_to_us_floor32(now - req->sent);
+            }
+        }
+
+        if (BT_MESH_ADDR_IS_UNICAST(req->dst)) {
+            req->used = false;
+        } else if (req->reply_count < MAX_REPLIERS) {
+            /* Beyond MAX_REPLIERS nodes the request absorbs every reply */
+            req->repliers[req->reply_count++] = ctx->addr;
+        }
+    }
+
+    k_spin_unlock(&lg_lock, key);
+}
+
+static void loadgen_reset(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&lg_lock);
+    struct bt_mesh_vendor_model_cli *cli = lg.cli;
+    struct loadgen_params params = lg.params;
+
+    memset(&lg, 0, sizeof(lg));
+    lg.cli = cli;
+    lg.params = params;
+    k_spin_unlock(&lg_lock, key);
+}
+
+static void loadgen_run(void)
+{
+    int64_t period, next, end;
+    uint32_t n = 0;
+
+    /* Stopped before the thread got to it */
+    if (!atomic_cas(&lg_state, LOADGEN_STARTING, LOADGEN_RUNNING)) {
+        return;
+    }
+
+    loadgen_reset();
+
+    period = k_us_to_ticks_ceil64(USEC_PER_SEC / lg.params.rate);
+    next = k_uptime_ticks();
+    end = next + k_ms_to_ticks_ceil64((uint64_t)lg.params.duration_s * MSEC_PER_SEC);
+    lg.start = next;
+
+    /* Sends that fall behind schedule go out back to back, so the offered
+     * rate holds even when a send blocks for a while.
+     */
+    while (atomic_get(&lg_state) == LOADGEN_RUNNING && next < end) {
+        k_sleep(K_TIMEOUT_ABS_TICKS(next));
+        send_one(n++);
+        pending_expire(k_uptime_ticks(), false);
+        next += period;
+    }
+
+    /* loadgen_stop() may have moved on to DRAINING already */
+    atomic_cas(&lg_state, LOADGEN_RUNNING, LOADGEN_DRAINING);
+    lg.end = k_uptime_ticks();
+
+    /* Give the last requests a chance to be answered */
+    k_sleep(K_MSEC(RSP_TIMEOUT_MS));
+    pending_expire(k_uptime_ticks(), true);
+
+    atomic_set(&lg_state, LOADGEN_IDLE);
+    loadgen_summary_print();
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static void print_rate(const char *label, uint32_t count, uint32_t window_ms)
+{
+    uint32_t rate_x10 = window_ms ? (uint64_t)count * 10000 / window_ms : 0;
+
+    printk("  %-10s: %u msgs (%u.%u msg/s)\n", label, count,
+           rate_x10 / 10, rate_x10 % 10);
+}
+
+static uint32_t percentile(uint32_t pct)
+{
+    return lg.samples[(lg.sample_count - 1) * pct / 100];
+}
+
+void loadgen_summary_print(void)
+{
+    uint32_t window_ms;
+    uint32_t offered = 0;
+
+    if (atomic_get(&lg_state) != LOADGEN_IDLE) {
+        printk("Load test still running\n");
+        return;
+    }
+
+    window_ms = k_ticks_to_ms_floor32(lg.end - lg.start);
+    for (int i = 0; i < LOADGEN_OP_COUNT; i++) {
+        offered += lg.offered[i];
+    }
+
+    printk("Load test: %u ms, %u destination(s)\n", window_ms,
+           lg.params.dst_count);
+    print_rate("offered", offered, window_ms);
+    printk("  %-10s: set %u get %u probe %u\n", "mix",
+           lg.offered[LOADGEN_OP_SET], lg.offered[LOADGEN_OP_GET],
+           lg.offered[LOADGEN_OP_PROBE]);
+    printk("  %-10s: %u ok, %u held, %u coalesced, %u -ENOBUFS, %u other errors\n",
+           "send", lg.sent, lg.held, lg.coalesced, lg.enobufs, lg.send_err);
+    print_rate("delivered", lg.delivered, window_ms);
+    /* Probes get no reply, so delivery is measured against requests */
+    printk("  %-10s: %u of %u requests (%u%%), %u responses, %u timeouts\n",
+           "replies", lg.delivered, lg.requests,
+           lg.requests ? (uint32_t)((uint64_t)lg.delivered * 100 / lg.requests) : 0,
+           lg.responses, lg.timeouts);
+
+    if (!lg.sample_count) {
+        return;
+    }
+
+    qsort(lg.samples, lg.sample_count, sizeof(lg.samples[0]), cmp_u32);
+    printk("  %-10s: p50 %u us, p90 %u us, p99 %u us, max %u us (%u samples)\n",
+           "latency", percentile(50), percentile(90), percentile(99),
+           lg.samples[lg.sample_count - 1], lg.sample_count);
+}
+
+int loadgen_start(const struct loadgen_params *params)
+{
+    uint32_t total = 0;
+
+    if (!lg.cli || !params->rate || params->rate > LOADGEN_RATE_MAX ||
+        !params->duration_s || params->duration_s > LOADGEN_DURATION_MAX_S ||
+        !params->dst_count ||
+        params->dst_count > CONFIG_BUTTON_CLIENT_LOADGEN_MAX_DST) {
+        return -EINVAL;
+    }
+
+    for (int i = 0; i < params->dst_count; i++) {
+        if (params->dst[i] == BT_MESH_ADDR_UNASSIGNED) {
+            return -EINVAL;
+        }
+    }
+
+    for (int i = 0; i < LOADGEN_OP_COUNT; i++) {
+        total += params->mix[i];
+    }
+    if (!total) {
+        return -EINVAL;
+    }
+
+    /* Refused until the previous run, including its drain, is done */
+    if (!atomic_cas(&lg_state, LOADGEN_IDLE, LOADGEN_STARTING)) {
+        return -EBUSY;
+    }
+
+    /* Nothing else touches the parameters outside IDLE */
+    lg.params = *params;
+
+    k_sem_give(&run_sem);
+    return 0;
+}
+
+void loadgen_stop(void)
+{
+    if (!atomic_cas(&lg_state, LOADGEN_RUNNING, LOADGEN_DRAINING)) {
+        atomic_cas(&lg_state, LOADGEN_STARTING, LOADGEN_IDLE);
+    }
+}
+
+void loadgen_init(struct bt_mesh_vendor_model_cli *cli)
+{
+    lg.cli = cli;
+}
+
+static void loadgen_thread_fn(void *p1, void *p2, void *p3)
+{
+#if defined(CONFIG_BUTTON_CLIENT_LOADGEN_AUTOSTART)
+    const struct loadgen_params auto_params = {
+        .rate = CONFIG_BUTTON_CLIENT_LOADGEN_AUTO_RATE,
+        .duration_s = CONFIG_BUTTON_CLIENT_LOADGEN_AUTO_DURATION,
+        .mix = {
+            [LOADGEN_OP_SET] = CONFIG_BUTTON_CLIENT_LOADGEN_AUTO_MIX_SET,
+            [LOADGEN_OP_GET] = CONFIG_BUTTON_CLIENT_LOADGEN_AUTO_MIX_GET,
+            [LOADGEN_OP_PROBE] = CONFIG_BUTTON_CLIENT_LOADGEN_AUTO_MIX_PROBE,
+        },
+        .dst = { CONFIG_BUTTON_CLIENT_LOADGEN_AUTO_DST },
+        .dst_count = 1,
+    };
+
+    while (!bt_mesh_is_provisioned()) {
+        k_sleep(K_SECONDS(1));
+    }
+
+    k_sleep(K_SECONDS(CONFIG_BUTTON_CLIENT_LOADGEN_AUTO_DELAY));
+    if (loadgen_start(&auto_params)) {
+        printk("Failed to start load test\n");
+    }
+#endif
+
+    while (1) {
+        k_sem_take(&run_sem, K_FOREVER);
+        loadgen_run();
+    }
+}
+
+K_THREAD_DEFINE(loadgen_thread, CONFIG_BUTTON_CLIENT_LOADGEN_STACK_SIZE,
+                loadgen_thread_fn, NULL, NULL, NULL,
+                K_LOWEST_APPLICATION_THREAD_PRIO, 0, 0);
+
+#if defined(CONFIG_SHELL)
+/* Parse a whole argument as a number no larger than max */
+static int parse_num(const char *str, char **end, unsigned long max,
+                     unsigned long *val)
+{
+    char *e;
+
+    errno = 0;
+    *val = strtoul(str, &e, 0);
+    if (errno || e == str || *val > max || (!end && *e)) {
+        return -EINVAL;
+    }
+
+    if (end) {
+        *end = e;
+    }
+    return 0;
+}
+
+static int cmd_start(const struct shell *sh, size_t argc, char **argv)
+{
+    struct loadgen_params params = { 0 };
+    char *mix = argv[3];
+    unsigned long val;
+    int err;
+
+    if (parse_num(argv[1], NULL, LOADGEN_RATE_MAX, &val) || !val) {
+        shell_error(sh, "Rate must be 1-%u msg/s", LOADGEN_RATE_MAX);
+        return -EINVAL;
+    }
+    params.rate = val;
+
+    if (parse_num(argv[2], NULL, LOADGEN_DURATION_MAX_S, &val) || !val) {
+        shell_error(sh, "Duration must be 1-%u s", LOADGEN_DURATION_MAX_S);
+        return -EINVAL;
+    }
+    params.duration_s = val;
+
+    /* Exactly set:get:probe, each weight 0-255 */
+    for (int i = 0; i < LOADGEN_OP_COUNT; i++) {
+        if (parse_num(mix, &mix, UINT8_MAX, &val) ||
+            *mix != (i == LOADGEN_OP_COUNT - 1 ? '\0' : ':')) {
+            shell_error(sh, "Mix must be set:get:probe weights of 0-255");
+            return -EINVAL;
+        }
+        params.mix[i] = val;
+        mix++;
+    }
+
+    for (int i = 4; i < argc; i++) {
+        if (params.dst_count == CONFIG_BUTTON_CLIENT_LOADGEN_MAX_DST) {
+            shell_error(sh, "Too many destinations");
+            return -EINVAL;
+        }
+        if (parse_num(argv[i], NULL, UINT16_MAX, &val) ||
+            val == BT_MESH_ADDR_UNASSIGNED) {
+            shell_error(sh, "Invalid destination %s", argv[i]);
+            return -EINVAL;
+        }
+        params.dst[params.dst_count++] = val;
+    }
+
+    err = loadgen_start(&params);
+    if (err) {
+        shell_error(sh, "Failed to start load test (err %d)", err);
+        return err;
+    }
+
+    shell_print(sh, "Load test started: %u msg/s for %u s, set:get:probe %u:%u:%u",
+                params.rate, params.duration_s, params.mix[LOADGEN_OP_SET],
+                params.mix[LOADGEN_OP_GET], params.mix[LOADGEN_OP_PROBE]);
+    return 0;
+}
+
+static int cmd_stop(const struct shell *sh, size_t argc, char **argv)
+{
+    loadgen_stop();
+    return 0;
+}
+
+static int cmd_stats(const struct shell *sh, size_t argc, char **argv)
+{
+    loadgen_summary_print();
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(loadgen_cmds,
+    SHELL_CMD_ARG(start, NULL,
+                  "<rate> <duration_s> <set:get:probe> <dst> [dst...]",
+                  cmd_start, 5, CONFIG_BUTTON_CLIENT_LOADGEN_MAX_DST - 1),
+    SHELL_CMD_ARG(stop, NULL, "Stop the running load test", cmd_stop, 1, 0),
+    SHELL_CMD_ARG(stats, NULL, "Print the last load test summary", cmd_stats, 1, 0),
+    SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(loadgen, &loadgen_cmds, "Vendor model load generator", NULL);
+#endif
@@ -1,12 +1,39 @@
 #include <zephyr/kernel.h>
+#include <zephyr/bluetooth/bluetooth.h>
 #include <zephyr/bluetooth/mesh.h>
 #include <zephyr/drivers/gpio.h>
+#include <zephyr/settings/settings.h>
+#include <dk_buttons_and_leds.h>
 #include "vendor_model.h"
 #include "device_config.h"
+#include "provisioner.h"
+#include "loadgen.h"
 
 /* Device UUID */
 static const uint8_t dev_uuid[16] = DEV_UUID;
 
+/* Attention: blink all LEDs until the timer expires */
+static void attention_blink(struct k_timer *timer)
+{
+    static bool on;
+
+    on = !on;
+    dk_set_leds(on ? DK_ALL_LEDS_MSK : DK_NO_LEDS_MSK);
+}
+
+static K_TIMER_DEFINE(attention_timer, attention_blink, NULL);
+
+static void attention_on(const struct bt_mesh_model *model)
+{
+    k_timer_start(&attention_timer, K_NO_WAIT, K_MSEC(250));
+}
+
+static void attention_off(const struct bt_mesh_model *model)
+{
+    k_timer_stop(&attention_timer);
+    dk_set_leds(DK_NO_LEDS_MSK);
+}
+
 /* Health Server */
 static struct bt_mesh_health_srv_cb health_srv_cb = HEALTH_SRV_CB;
 
@@ -14,27 +41,49 @@ static struct bt_mesh_health_srv health_srv = {
     .cb = &health_srv_cb,
 };
 
-static struct bt_mesh_model_pub health_pub = HEALTH_PUB;
+BT_MESH_HEALTH_PUB_DEFINE(health_pub, HEALTH_FAULT_COUNT);
 
 /* Provisioning */
 static const struct bt_mesh_prov prov = {
     .uuid = dev_uuid,
+#if defined(CONFIG_BUTTON_CLIENT_PROVISIONER)
+    .unprovisioned_beacon = provisioner_unprovisioned_beacon,
+    .node_added = provisioner_node_added,
+    .link_close = provisioner_link_close,
+#endif
 };
 
+#if defined(CONFIG_BUTTON_CLIENT_PROVISIONER)
+/* Config Client, used to push the configuration template */
+static struct bt_mesh_cfg_cli cfg_cli;
+#endif
+
 /* Button handling */
 static const struct gpio_dt_spec button = GPIO_DT_SPEC_GET(DT_ALIAS(sw0), gpios);
-static struct k_work button_work;
+static struct vendor_model_work button_work;
 
 /* Forward declaration of vendor client */
 static struct bt_mesh_vendor_model_cli vendor_client;
 
 static void button_pressed_work_handler(struct k_work *work)
 {
+#if defined(CONFIG_BUTTON_CLIENT_TIMED_SET)
+    static uint8_t led_state = LED_OFF;
+
+    /* Every server switches at the same network time */
+    led_state = led_state == LED_ON ? LED_OFF : LED_ON;
+    bt_mesh_vendor_model_cli_led_set_at(&vendor_client, BT_MESH_ADDR_ALL_NODES,
+                                        0, led_state,
+                                        CONFIG_BUTTON_CLIENT_TIMED_SET_DELAY_MS *
+                                        USEC_PER_MSEC);
+#else
     struct button_press press = {
         .button_index = 0,
         .button_state = 1
     };
-    bt_mesh_vendor_model_cli_button_press(&vendor_client, &press);
+    bt_mesh_vendor_model_cli_button_press(&vendor_client, BT_MESH_ADDR_ALL_NODES,
+                                          &press);
+#endif
 }
 
 /* Vendor Model handlers */
@@ -42,8 +91,12 @@ static void handle_led_status(struct bt_mesh_vendor_model_cli *cli,
                            struct bt_mesh_msg_ctx *ctx,
                            struct led_status *status)
 {
-    printk("LED %d is %s\n", status->led_index,
+    VENDOR_MODEL_PRINTK("LED %d is %s\n", status->led_index,
            status->led_state == LED_ON ? "on" : "off");
+
+#if defined(CONFIG_BUTTON_CLIENT_LOADGEN)
+    loadgen_status_received(ctx, status);
+#endif
 }
 
 static const struct vendor_model_cli_handlers cli_handlers = {
@@ -56,15 +109,27 @@ BT_MESH_VENDOR_MODEL_CLI_DEFINE(vendor_client, cli_handlers);
 /* Element Definition */
 static struct bt_mesh_model models[] = {
     BT_MESH_MODEL_CFG_SRV,
+#if defined(CONFIG_BUTTON_CLIENT_PROVISIONER)
+    BT_MESH_MODEL_CFG_CLI(&cfg_cli),
+#endif
     BT_MESH_MODEL_HEALTH_SRV(&health_srv, &health_pub),
     BT_MESH_MODEL_VND_CB(BT_MESH_VENDOR_COMPANY_ID,
                       BT_MESH_VENDOR_MODEL_ID_CLI,
                       vendor_cli_op,
                       NULL,
                       &vendor_client,
-                      NULL),
+                      &vendor_cli_cb),
 };
 
+/* Held commands replaced in the client's slot table. Button work that was
+ * still queued is not counted: the button GPIO is not debounced, so
+ * contact bounce alone would raise the fault.
+ */
+static uint32_t cmd_superseded_get(void)
+{
+    return bt_mesh_vendor_model_cli_coalesced_get(&vendor_client);
+}
+
 static struct bt_mesh_elem elements[] = {
     BT_MESH_ELEM(0, models, BT_MESH_MODEL_NONE),
 };
@@ -78,7 +143,7 @@ static const struct bt_mesh_comp comp = {
 static void button_pressed(const struct device *dev, struct gpio_callback *cb,
                          uint32_t pins)
 {
-    k_work_submit(&button_work);
+    vendor_model_work_submit(&button_work);
 }
 
 static void configure_button(void)
@@ -117,9 +182,24 @@ int main(void)
 
     printk("Initializing...\n");
 
-    k_work_init(&button_work, button_pressed_work_handler);
+    err = dk_leds_init();
+    if (err) {
+        printk("LEDs init failed (err %d)\n", err);
+    }
+
+    vendor_model_work_init(&button_work, button_pressed_work_handler);
     configure_button();
 
+#if defined(CONFIG_BUTTON_CLIENT_LOADGEN)
+    loadgen_init(&vendor_client);
+#endif
+
+    err = bt_enable(NULL);
+    if (err) {
+        printk("Bluetooth init failed (err %d)\n", err);
+        return 0;
+    }
+
     /* Initialize the Bluetooth Mesh Stack */
     err = bt_mesh_init(&prov, &comp);
     if (err) {
@@ -127,12 +207,31 @@ int main(void)
         return 0;
     }
 
-    /* Enable provisioning */
-    err = bt_mesh_prov_enable(BT_MESH_PROV_ADV | BT_MESH_PROV_GATT);
+    if (IS_ENABLED(CONFIG_SETTINGS)) {
+        settings_load();
+    }
+
+    health_faults_init(&elements[0], cmd_superseded_get);
+
+#if defined(CONFIG_BUTTON_CLIENT_PROVISIONER)
+    /* Act as the network provisioner instead of waiting to be provisioned */
+    err = provisioner_start();
     if (err) {
-        printk("Failed to enable provisioning (err %d)\n", err);
+        printk("Failed to start provisioner (err %d)\n", err);
         return 0;
     }
+#else
+    /* Enable provisioning, unless restored from settings */
+    if (bt_mesh_is_provisioned()) {
+        printk("Using stored network settings\n");
+    } else {
+        err = bt_mesh_prov_enable(BT_MESH_PROV_ADV | BT_MESH_PROV_GATT);
+        if (err) {
+            printk("Failed to enable provisioning (err %d)\n", err);
+            return 0;
+        }
+    }
+#endif
 
     printk("Mesh initialized\n");
 
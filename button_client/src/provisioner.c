@@ -0,0 +1,420 @@
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/crypto.h>
+#include <zephyr/bluetooth/mesh.h>
+#include <string.h>
+#include "vendor_model.h"
+#include "device_config.h"
+#include "provisioner.h"
+
+/* Configuration template pushed to every node added to the network */
+static const struct prov_template {
+    uint16_t net_idx;
+    uint16_t app_idx;
+    uint16_t group_addr;
+    uint16_t health_pub_addr;
+} tmpl = {
+    .net_idx = BT_MESH_NET_PRIMARY,
+    .app_idx = CONFIG_BUTTON_CLIENT_PROV_APP_IDX,
+    .group_addr = CONFIG_BUTTON_CLIENT_PROV_GROUP_ADDR,
+    .health_pub_addr = CONFIG_BUTTON_CLIENT_PROV_HEALTH_PUB_ADDR,
+};
+
+static const uint8_t uuid_prefix[] = LIGHT_SERVER_UUID_PREFIX;
+
+/* Devices waiting to be provisioned. A slot stays in use until the
+ * provisioning attempt for it completes, so repeated beacons from the same
+ * device are not queued twice.
+ */
+static struct {
+    uint8_t uuid[16];
+    bool used;
+} pending[CONFIG_BUTTON_CLIENT_PROV_QUEUE_SIZE];
+static struct k_spinlock pending_lock;
+
+/* Set once provisioning failed for a reason that retrying cannot fix */
+static atomic_t prov_stopped;
+
+/* Stage 1: pending slot indices ready for provisioning */
+K_MSGQ_DEFINE(prov_q, sizeof(uint8_t), CONFIG_BUTTON_CLIENT_PROV_QUEUE_SIZE, 1);
+/* Stage 2: unicast addresses of provisioned nodes ready for configuration */
+K_MSGQ_DEFINE(config_q, sizeof(uint16_t), CONFIG_BUTTON_CLIENT_PROV_QUEUE_SIZE, 2);
+
+/* Given when the provisioning link closes, whether or not the node was
+ * added, so a failing device does not hold up the queue.
+ */
+static K_SEM_DEFINE(sem_link_closed, 0, 1);
+
+static K_THREAD_STACK_DEFINE(prov_stack, CONFIG_BUTTON_CLIENT_PROV_STACK_SIZE);
+static K_THREAD_STACK_DEFINE(config_stack, CONFIG_BUTTON_CLIENT_PROV_STACK_SIZE);
+static struct k_thread prov_thread;
+static struct k_thread config_thread;
+
+void provisioner_unprovisioned_beacon(uint8_t uuid[16],
+                                      bt_mesh_prov_oob_info_t oob_info,
+                                      uint32_t *uri_hash)
+{
+    k_spinlock_key_t key;
+    int free_slot = -1;
+
+    if (atomic_get(&prov_stopped) ||
+        memcmp(uuid, uuid_prefix, sizeof(uuid_prefix))) {
+        return;
+    }
+
+    key = k_spin_lock(&pending_lock);
+    for (int i = 0; i < ARRAY_SIZE(pending); i++) {
+        if (!pending[i].used) {
+            if (free_slot < 0) {
+                free_slot = i;
+            }
+        } else if (!memcmp(pending[i].uuid, uuid, 16)) {
+            k_spin_unlock(&pending_lock, key);
+            return;
+        }
+    }
+
+    if (free_slot >= 0) {
+        memcpy(pending[free_slot].uuid, uuid, 16);
+        pending[free_slot].used = true;
+    }
+    k_spin_unlock(&pending_lock, key);
+
+    if (free_slot >= 0) {
+        uint8_t slot = free_slot;
+
+        /* Queue is as deep as the slot table, so this cannot fail */
+        k_msgq_put(&prov_q, &slot, K_NO_WAIT);
+    }
+}
+
+void provisioner_node_added(uint16_t net_idx, uint8_t uuid[16],
+                            uint16_t addr, uint8_t num_elem)
+{
+    printk("Node 0x%04x added (%d elements)\n", addr, num_elem);
+
+    /* If the queue is full the node is picked up by the next CDB sweep */
+    k_msgq_put(&config_q, &addr, K_NO_WAIT);
+}
+
+void provisioner_link_close(bt_mesh_prov_bearer_t bearer)
+{
+    k_sem_give(&sem_link_closed);
+}
+
+static void release_slot(uint8_t slot)
+{
+    k_spinlock_key_t key = k_spin_lock(&pending_lock);
+
+    pending[slot].used = false;
+    k_spin_unlock(&pending_lock, key);
+}
+
+static void prov_thread_fn(void *p1, void *p2, void *p3)
+{
+    uint8_t slot;
+    int err;
+
+    while (1) {
+        k_msgq_get(&prov_q, &slot, K_FOREVER);
+        k_sem_reset(&sem_link_closed);
+
+        if (atomic_get(&prov_stopped)) {
+            release_slot(slot);
+            continue;
+        }
+
+        /* Address 0 lets the CDB pick the lowest free unicast range */
+        err = bt_mesh_provision_adv(pending[slot].uuid, tmpl.net_idx, 0, 0);
+        if (err == -ENOMEM || err == -ENOSPC || err == -EEXIST) {
+            /* No room left in the CDB (CONFIG_BT_MESH_CDB_NODE_COUNT) or
+             * no free address. Every further beacon would fail the same
+             * way, so stop queuing devices instead of looping.
+             */
+            printk("Provisioning stopped (err %d), CDB full\n", err);
+            atomic_set(&prov_stopped, 1);
+        } else if (err) {
+            printk("Provisioning failed (err %d)\n", err);
+        } else if (k_sem_take(&sem_link_closed,
+                              K_SECONDS(CONFIG_BUTTON_CLIENT_PROV_TIMEOUT))) {
+            printk("Provisioning timed out\n");
+        }
+
+        /* A device that was not added keeps beaconing and is retried */
+        release_slot(slot);
+    }
+}
+
+static int app_key_get(uint8_t app_key[16])
+{
+    struct bt_mesh_cdb_app_key *key = bt_mesh_cdb_app_key_get(tmpl.app_idx);
+
+    if (!key) {
+        return -ENOENT;
+    }
+
+    return bt_mesh_cdb_app_key_export(key, 0, app_key);
+}
+
+static int net_key_get(uint8_t net_key[16])
+{
+    struct bt_mesh_cdb_subnet *sub = bt_mesh_cdb_subnet_get(tmpl.net_idx);
+
+    if (!sub) {
+        return -ENOENT;
+    }
+
+    return bt_mesh_cdb_subnet_key_export(sub, 0, net_key);
+}
+
+static int configure_models(struct bt_mesh_cdb_node *node,
+                            struct bt_mesh_comp_p0_elem *elem,
+                            uint16_t elem_addr)
+{
+    uint8_t status;
+    int err;
+
+    for (int i = 0; i < elem->nvnd; i++) {
+        struct bt_mesh_mod_id_vnd id = bt_mesh_comp_p0_elem_mod_vnd(elem, i);
+
+        if (id.company != BT_MESH_VENDOR_COMPANY_ID) {
+            continue;
+        }
+
+        err = bt_mesh_cfg_cli_mod_app_bind_vnd(node->net_idx, node->addr,
+                                               elem_addr, tmpl.app_idx,
+                                               id.id, id.company, &status);
+        if (err || status) {
+            printk("Bind of model 0x%04x on 0x%04x failed (err %d, status %d)\n",
+                   id.id, elem_addr, err, status);
+            return err ? err : -EIO;
+        }
+
+        err = bt_mesh_cfg_cli_mod_sub_add_vnd(node->net_idx, node->addr,
+                                              elem_addr, tmpl.group_addr,
+                                              id.id, id.company, &status);
+        if (err || status) {
+            printk("Subscribe of model 0x%04x on 0x%04x failed (err %d, status %d)\n",
+                   id.id, elem_addr, err, status);
+            return err ? err : -EIO;
+        }
+    }
+
+    return 0;
+}
+
+/* Publish Health Server faults, which are raised on the primary element */
+static int configure_health(struct bt_mesh_cdb_node *node)
+{
+    struct bt_mesh_cfg_cli_mod_pub pub = {
+        .addr = tmpl.health_pub_addr,
+        .app_idx = tmpl.app_idx,
+        .ttl = BT_MESH_TTL_DEFAULT,
+    };
+    uint8_t status;
+    int err;
+
+    err = bt_mesh_cfg_cli_mod_app_bind(node->net_idx, node->addr, node->addr,
+                                       tmpl.app_idx, BT_MESH_MODEL_ID_HEALTH_SRV,
+                                       &status);
+    if (err || status) {
+        printk("Bind of Health Server on 0x%04x failed (err %d, status %d)\n",
+               node->addr, err, status);
+        return err ? err : -EIO;
+    }
+
+    err = bt_mesh_cfg_cli_mod_pub_set(node->net_idx, node->addr, node->addr,
+                                      BT_MESH_MODEL_ID_HEALTH_SRV, &pub, &status);
+    if (err || status) {
+        printk("Health publication on 0x%04x failed (err %d, status %d)\n",
+               node->addr, err, status);
+        return err ? err : -EIO;
+    }
+
+    return 0;
+}
+
+static int configure_node(struct bt_mesh_cdb_node *node)
+{
+    NET_BUF_SIMPLE_DEFINE(buf, BT_MESH_RX_SDU_MAX);
+    struct bt_mesh_comp_p0_elem elem;
+    struct bt_mesh_comp_p0 comp;
+    uint8_t app_key[16];
+    uint16_t elem_addr;
+    uint8_t status;
+    int err;
+
+    printk("Configuring node 0x%04x\n", node->addr);
+
+    err = app_key_get(app_key);
+    if (err) {
+        printk("Failed to get app key (err %d)\n", err);
+        return err;
+    }
+
+    err = bt_mesh_cfg_cli_app_key_add(node->net_idx, node->addr, node->net_idx,
+                                      tmpl.app_idx, app_key, &status);
+    if (err || status) {
+        printk("Failed to add app key (err %d, status %d)\n", err, status);
+        return err ? err : -EIO;
+    }
+
+    err = bt_mesh_cfg_cli_comp_data_get(node->net_idx, node->addr, 0,
+                                        &status, &buf);
+    if (err) {
+        printk("Failed to get composition data (err %d)\n", err);
+        return err;
+    }
+
+    err = bt_mesh_comp_p0_get(&comp, &buf);
+    if (err) {
+        printk("Unable to parse composition data (err %d)\n", err);
+        return err;
+    }
+
+    elem_addr = node->addr;
+    while (bt_mesh_comp_p0_elem_pull(&comp, &elem)) {
+        err = configure_models(node, &elem, elem_addr);
+        if (err) {
+            return err;
+        }
+        elem_addr++;
+    }
+
+    err = configure_health(node);
+    if (err) {
+        return err;
+    }
+
+    atomic_set_bit(node->flags, BT_MESH_CDB_NODE_CONFIGURED);
+    if (IS_ENABLED(CONFIG_BT_SETTINGS)) {
+        bt_mesh_cdb_node_store(node);
+    }
+
+    printk("Node 0x%04x configured\n", node->addr);
+    return 0;
+}
+
+static uint8_t queue_unconfigured(struct bt_mesh_cdb_node *node, void *data)
+{
+    if (!atomic_test_bit(node->flags, BT_MESH_CDB_NODE_CONFIGURED)) {
+        k_msgq_put(&config_q, &node->addr, K_NO_WAIT);
+    }
+
+    return BT_MESH_CDB_ITER_CONTINUE;
+}
+
+static void config_thread_fn(void *p1, void *p2, void *p3)
+{
+    struct bt_mesh_cdb_node *node;
+    uint16_t addr;
+
+    while (1) {
+        /* When idle, sweep the CDB for nodes whose configuration failed
+         * or was interrupted by a reset.
+         */
+        if (k_msgq_get(&config_q, &addr, K_SECONDS(30))) {
+            bt_mesh_cdb_node_foreach(queue_unconfigured, NULL);
+            continue;
+        }
+
+        node = bt_mesh_cdb_node_get(addr);
+        if (!node || atomic_test_bit(node->flags, BT_MESH_CDB_NODE_CONFIGURED)) {
+            continue;
+        }
+
+        configure_node(node);
+    }
+}
+
+static int setup_app_key(void)
+{
+    struct bt_mesh_cdb_app_key *key;
+    uint8_t app_key[16];
+    int err;
+
+    key = bt_mesh_cdb_app_key_alloc(tmpl.net_idx, tmpl.app_idx);
+    if (!key) {
+        return -ENOMEM;
+    }
+
+    err = bt_rand(app_key, sizeof(app_key));
+    if (err) {
+        return err;
+    }
+
+    err = bt_mesh_cdb_app_key_import(key, 0, app_key);
+    if (err) {
+        return err;
+    }
+
+    if (IS_ENABLED(CONFIG_BT_SETTINGS)) {
+        bt_mesh_cdb_app_key_store(key);
+    }
+
+    return 0;
+}
+
+int provisioner_start(void)
+{
+    uint8_t net_key[16];
+    uint8_t dev_key[16];
+    int err;
+
+    err = bt_rand(net_key, sizeof(net_key));
+    if (err) {
+        return err;
+    }
+
+    err = bt_mesh_cdb_create(net_key);
+    if (err == -EALREADY) {
+        printk("Using stored CDB\n");
+        /* Self-provision with the stored network, not the random key */
+        err = net_key_get(net_key);
+        if (err) {
+            printk("Failed to get net key (err %d)\n", err);
+            return err;
+        }
+    } else if (err) {
+        printk("Failed to create CDB (err %d)\n", err);
+        return err;
+    } else {
+        printk("Created CDB\n");
+        err = setup_app_key();
+        if (err) {
+            printk("Failed to set up app key (err %d)\n", err);
+            return err;
+        }
+    }
+
+    err = bt_rand(dev_key, sizeof(dev_key));
+    if (err) {
+        return err;
+    }
+
+    err = bt_mesh_provision(net_key, tmpl.net_idx, 0, 0,
+                            CONFIG_BUTTON_CLIENT_PROV_SELF_ADDR, dev_key);
+    if (err == -EALREADY) {
+        printk("Using stored network settings\n");
+    } else if (err) {
+        printk("Self-provisioning failed (err %d)\n", err);
+        return err;
+    }
+
+    k_thread_create(&config_thread, config_stack,
+                    K_THREAD_STACK_SIZEOF(config_stack), config_thread_fn,
+                    NULL, NULL, NULL, K_LOWEST_APPLICATION_THREAD_PRIO, 0,
+                    K_NO_WAIT);
+    k_thread_name_set(&config_thread, "prov_config");
+
+    k_thread_create(&prov_thread, prov_stack,
+                    K_THREAD_STACK_SIZEOF(prov_stack), prov_thread_fn,
+                    NULL, NULL, NULL, K_LOWEST_APPLICATION_THREAD_PRIO, 0,
+                    K_NO_WAIT);
+    k_thread_name_set(&prov_thread, "prov_adv");
+
+    /* Configure this node (and anything left over from before a reset) */
+    bt_mesh_cdb_node_foreach(queue_unconfigured, NULL);
+
+    printk("Provisioner started, scanning for light servers\n");
+    return 0;
+}
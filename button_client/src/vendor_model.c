@@ -1,3 +1,4 @@
+#include <zephyr/kernel.h>
 #include <zephyr/bluetooth/mesh.h>
 #include <zephyr/sys/util.h>
 #include "vendor_model.h"
@@ -32,31 +33,230 @@ const struct bt_mesh_model_op vendor_cli_op[] = {
 };
 
 /* Client API Implementation */
-int bt_mesh_vendor_model_cli_led_set(struct bt_mesh_vendor_model_cli *cli,
-                                   uint8_t led_index,
-                                   uint8_t led_state)
+static void cli_send_end(int err, void *cb_data)
 {
-    if (!cli || !cli->model) {
-        return -EINVAL;
+    struct bt_mesh_vendor_model_cli *cli = cb_data;
+
+    /* A buffer was just released, push out whatever is waiting for one */
+    if (cli->pending_count) {
+        vendor_model_work_submit(&cli->drain_work);
     }
+}
 
-    BT_MESH_MODEL_BUF_DEFINE(msg, BT_MESH_VENDOR_OP_LED_SET,
-                            BT_MESH_VENDOR_MSG_MAXLEN_MESSAGE);
-    
-    bt_mesh_model_msg_init(&msg, BT_MESH_VENDOR_OP_LED_SET);
-    net_buf_simple_add_u8(&msg, led_index);
-    net_buf_simple_add_u8(&msg, led_state);
+static const struct bt_mesh_send_cb cli_send_cb = {
+    .end = cli_send_end,
+};
 
+static int cli_send(struct bt_mesh_vendor_model_cli *cli, uint16_t addr,
+                    struct net_buf_simple *msg)
+{
     struct bt_mesh_msg_ctx ctx = {
-        .addr = BT_MESH_ADDR_ALL_NODES,
+        .addr = addr,
         .app_idx = cli->model->keys[0],
         .send_ttl = BT_MESH_TTL_DEFAULT,
     };
 
-    return bt_mesh_model_send(cli->model, &ctx, &msg, NULL, NULL);
+    int err = bt_mesh_model_send(cli->model, &ctx, msg, &cli_send_cb, cli);
+
+    vendor_model_send_count(err);
+
+    return err;
+}
+
+/* LED Set and Button Press share the same two byte payload */
+static int cli_send_cmd(struct bt_mesh_vendor_model_cli *cli, uint32_t opcode,
+                        uint16_t addr, uint8_t led_index, uint8_t value)
+{
+    BT_MESH_MODEL_BUF_DEFINE(msg, BT_MESH_VENDOR_OP_LED_SET,
+                            BT_MESH_VENDOR_MSG_MAXLEN_MESSAGE);
+
+    bt_mesh_model_msg_init(&msg, opcode);
+    net_buf_simple_add_u8(&msg, led_index);
+    net_buf_simple_add_u8(&msg, value);
+
+    return cli_send(cli, addr, &msg);
+}
+
+static struct bt_mesh_vendor_model_cli_slot *
+cli_slot_find(struct bt_mesh_vendor_model_cli *cli, uint32_t opcode,
+              uint16_t addr, uint8_t led_index)
+{
+    for (int i = 0; i < ARRAY_SIZE(cli->slots); i++) {
+        struct bt_mesh_vendor_model_cli_slot *slot = &cli->slots[i];
+
+        if (slot->pending && slot->opcode == opcode && slot->addr == addr &&
+            slot->led_index == led_index) {
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+static struct bt_mesh_vendor_model_cli_slot *
+cli_slot_oldest(struct bt_mesh_vendor_model_cli *cli)
+{
+    struct bt_mesh_vendor_model_cli_slot *oldest = NULL;
+
+    for (int i = 0; i < ARRAY_SIZE(cli->slots); i++) {
+        struct bt_mesh_vendor_model_cli_slot *slot = &cli->slots[i];
+
+        if (slot->pending &&
+            (!oldest || (int32_t)(slot->seq - oldest->seq) < 0)) {
+            oldest = slot;
+        }
+    }
+
+    return oldest;
+}
+
+/* Called with slot_lock held. A timer that is already running is left
+ * alone: restarting it on every held command would keep pushing the retry
+ * out for as long as new commands keep arriving.
+ */
+static void cli_retry_arm(struct bt_mesh_vendor_model_cli *cli)
+{
+    if (!k_timer_remaining_get(&cli->retry_timer)) {
+        k_timer_start(&cli->retry_timer,
+                      K_MSEC(CONFIG_VENDOR_MODEL_CLI_RETRY_MS), K_NO_WAIT);
+    }
+}
+
+static int cli_send_latest(struct bt_mesh_vendor_model_cli *cli,
+                           uint32_t opcode, uint16_t addr,
+                           uint8_t led_index, uint8_t value)
+{
+    struct bt_mesh_vendor_model_cli_slot *slot;
+    int err = 0;
+
+    k_mutex_lock(&cli->slot_lock, K_FOREVER);
+
+    /* Supersede a command for the same target that is still waiting,
+     * sending directly would let the stale one go out after this one.
+     */
+    slot = cli_slot_find(cli, opcode, addr, led_index);
+    if (slot) {
+        slot->value = value;
+        cli->coalesced++;
+        err = -EALREADY;
+        goto unlock;
+    }
+
+    err = cli_send_cmd(cli, opcode, addr, led_index, value);
+    if (err != -ENOBUFS) {
+        goto unlock;
+    }
+
+    /* No buffer: hold the command until the send-end callback drains it */
+    for (int i = 0; !slot && i < ARRAY_SIZE(cli->slots); i++) {
+        if (!cli->slots[i].pending) {
+            slot = &cli->slots[i];
+        }
+    }
+
+    if (!slot) {
+        goto unlock;
+    }
+
+    slot->opcode = opcode;
+    slot->seq = cli->seq++;
+    slot->addr = addr;
+    slot->led_index = led_index;
+    slot->value = value;
+    slot->pending = true;
+    cli->pending_count++;
+    err = -EINPROGRESS;
+
+    cli_retry_arm(cli);
+
+unlock:
+    k_mutex_unlock(&cli->slot_lock);
+    return err;
+}
+
+static void cli_drain_work_handler(struct k_work *work)
+{
+    struct vendor_model_work *vwork =
+        CONTAINER_OF(work, struct vendor_model_work, work);
+    struct bt_mesh_vendor_model_cli *cli =
+        CONTAINER_OF(vwork, struct bt_mesh_vendor_model_cli, drain_work);
+    struct bt_mesh_vendor_model_cli_slot *slot;
+    int err;
+
+    k_mutex_lock(&cli->slot_lock, K_FOREVER);
+
+    while ((slot = cli_slot_oldest(cli))) {
+        err = cli_send_cmd(cli, slot->opcode, slot->addr, slot->led_index,
+                           slot->value);
+        if (err == -ENOBUFS) {
+            cli_retry_arm(cli);
+            break;
+        }
+
+        if (err) {
+            VENDOR_MODEL_PRINTK("Dropped command to 0x%04x (err %d)\n", slot->addr, err);
+        }
+
+        slot->pending = false;
+        cli->pending_count--;
+    }
+
+    k_mutex_unlock(&cli->slot_lock);
+}
+
+static void cli_retry_timeout(struct k_timer *timer)
+{
+    struct bt_mesh_vendor_model_cli *cli =
+        CONTAINER_OF(timer, struct bt_mesh_vendor_model_cli, retry_timer);
+
+    vendor_model_work_submit(&cli->drain_work);
+}
+
+#if defined(CONFIG_VENDOR_MODEL_NET_TIME)
+/* Time beacon scheduling, with the rest of the network time code below */
+static void beacon_work_handler(struct k_work *work);
+static void beacon_timeout(struct k_timer *timer);
+#endif
+
+static int vendor_cli_init(const struct bt_mesh_model *model)
+{
+    struct bt_mesh_vendor_model_cli *cli = model->user_data;
+
+    cli->model = model;
+    k_mutex_init(&cli->slot_lock);
+    k_timer_init(&cli->retry_timer, cli_retry_timeout, NULL);
+    vendor_model_work_init(&cli->drain_work, cli_drain_work_handler);
+
+#if defined(CONFIG_VENDOR_MODEL_NET_TIME)
+    vendor_model_work_init(&cli->beacon_work, beacon_work_handler);
+    k_timer_init(&cli->beacon_timer, beacon_timeout, NULL);
+    k_timer_start(&cli->beacon_timer,
+                  K_SECONDS(CONFIG_VENDOR_MODEL_NET_TIME_BEACON_PERIOD_S),
+                  K_SECONDS(CONFIG_VENDOR_MODEL_NET_TIME_BEACON_PERIOD_S));
+#endif
+
+    return 0;
+}
+
+const struct bt_mesh_model_cb vendor_cli_cb = {
+    .init = vendor_cli_init,
+};
+
+int bt_mesh_vendor_model_cli_led_set(struct bt_mesh_vendor_model_cli *cli,
+                                   uint16_t addr,
+                                   uint8_t led_index,
+                                   uint8_t led_state)
+{
+    if (!cli || !cli->model) {
+        return -EINVAL;
+    }
+
+    return cli_send_latest(cli, BT_MESH_VENDOR_OP_LED_SET, addr, led_index,
+                           led_state);
 }
 
 int bt_mesh_vendor_model_cli_led_get(struct bt_mesh_vendor_model_cli *cli,
+                                   uint16_t addr,
                                    uint8_t led_index)
 {
     if (!cli || !cli->model) {
@@ -69,34 +269,126 @@ int bt_mesh_vendor_model_cli_led_get(struct bt_mesh_vendor_model_cli *cli,
     bt_mesh_model_msg_init(&msg, BT_MESH_VENDOR_OP_LED_GET);
     net_buf_simple_add_u8(&msg, led_index);
 
-    struct bt_mesh_msg_ctx ctx = {
-        .addr = BT_MESH_ADDR_ALL_NODES,
-        .app_idx = cli->model->keys[0],
-        .send_ttl = BT_MESH_TTL_DEFAULT,
-    };
-
-    return bt_mesh_model_send(cli->model, &ctx, &msg, NULL, NULL);
+    return cli_send(cli, addr, &msg);
 }
 
 int bt_mesh_vendor_model_cli_button_press(struct bt_mesh_vendor_model_cli *cli,
+                                        uint16_t addr,
                                         struct button_press *press)
 {
     if (!cli || !cli->model || !press) {
         return -EINVAL;
     }
 
-    BT_MESH_MODEL_BUF_DEFINE(msg, BT_MESH_VENDOR_OP_BUTTON_PRESS,
+    return cli_send_latest(cli, BT_MESH_VENDOR_OP_BUTTON_PRESS, addr,
+                           press->button_index, press->button_state);
+}
+
+uint32_t bt_mesh_vendor_model_cli_coalesced_get(struct bt_mesh_vendor_model_cli *cli)
+{
+    return cli->coalesced;
+}
+
+#if defined(CONFIG_VENDOR_MODEL_NET_TIME)
+uint32_t vendor_model_net_time_us(void)
+{
+    return (uint32_t)k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+int bt_mesh_vendor_model_cli_led_set_at(struct bt_mesh_vendor_model_cli *cli,
+                                      uint16_t addr,
+                                      uint8_t led_index,
+                                      uint8_t led_state,
+                                      uint32_t delay_us)
+{
+    if (!cli || !cli->model) {
+        return -EINVAL;
+    }
+
+    BT_MESH_MODEL_BUF_DEFINE(msg, BT_MESH_VENDOR_OP_LED_SET_AT,
+                            BT_MESH_VENDOR_MSG_MAXLEN_MESSAGE);
+
+    bt_mesh_model_msg_init(&msg, BT_MESH_VENDOR_OP_LED_SET_AT);
+    net_buf_simple_add_u8(&msg, led_index);
+    net_buf_simple_add_u8(&msg, led_state);
+    net_buf_simple_add_le32(&msg, vendor_model_net_time_us() + delay_us);
+
+    return cli_send(cli, addr, &msg);
+}
+
+static void beacon_send_start(uint16_t duration, int err, void *cb_data)
+{
+    struct bt_mesh_vendor_model_cli *cli = cb_data;
+
+    /* Taken when the beacon goes on air, reported in the next beacon */
+    if (!err) {
+        cli->beacon_tx_us = vendor_model_net_time_us();
+    }
+}
+
+static const struct bt_mesh_send_cb beacon_send_cb = {
+    .start = beacon_send_start,
+    .end = cli_send_end,
+};
+
+int bt_mesh_vendor_model_cli_time_beacon_send(struct bt_mesh_vendor_model_cli *cli,
+                                            uint16_t addr)
+{
+    uint8_t ttl = bt_mesh_default_ttl_get();
+    int err;
+
+    if (!cli || !cli->model) {
+        return -EINVAL;
+    }
+
+    BT_MESH_MODEL_BUF_DEFINE(msg, BT_MESH_VENDOR_OP_TIME_BEACON,
                             BT_MESH_VENDOR_MSG_MAXLEN_MESSAGE);
-    
-    bt_mesh_model_msg_init(&msg, BT_MESH_VENDOR_OP_BUTTON_PRESS);
-    net_buf_simple_add_u8(&msg, press->button_index);
-    net_buf_simple_add_u8(&msg, press->button_state);
 
+    bt_mesh_model_msg_init(&msg, BT_MESH_VENDOR_OP_TIME_BEACON);
+    net_buf_simple_add_u8(&msg, cli->beacon_seq);
+    net_buf_simple_add_u8(&msg, ttl);
+    net_buf_simple_add_le32(&msg, cli->beacon_tx_us);
+
+    /* Receivers derive the hop count from the TTL, so send with the
+     * exact value in the payload rather than BT_MESH_TTL_DEFAULT.
+     */
     struct bt_mesh_msg_ctx ctx = {
-        .addr = BT_MESH_ADDR_ALL_NODES,
+        .addr = addr,
         .app_idx = cli->model->keys[0],
-        .send_ttl = BT_MESH_TTL_DEFAULT,
+        .send_ttl = ttl,
     };
 
-    return bt_mesh_model_send(cli->model, &ctx, &msg, NULL, NULL);
+    cli->beacon_tx_us = 0;
+    err = bt_mesh_model_send(cli->model, &ctx, &msg, &beacon_send_cb, cli);
+    vendor_model_send_count(err);
+
+    if (!err) {
+        cli->beacon_seq++;
+    }
+
+    return err;
+}
+
+static void beacon_work_handler(struct k_work *work)
+{
+    struct vendor_model_work *vwork =
+        CONTAINER_OF(work, struct vendor_model_work, work);
+    struct bt_mesh_vendor_model_cli *cli =
+        CONTAINER_OF(vwork, struct bt_mesh_vendor_model_cli, beacon_work);
+
+    if (!bt_mesh_is_provisioned() || cli->model->keys[0] == BT_MESH_KEY_UNUSED) {
+        return;
+    }
+
+    bt_mesh_vendor_model_cli_time_beacon_send(cli,
+                                              CONFIG_VENDOR_MODEL_NET_TIME_BEACON_ADDR);
+}
+
+static void beacon_timeout(struct k_timer *timer)
+{
+    struct bt_mesh_vendor_model_cli *cli =
+        CONTAINER_OF(timer, struct bt_mesh_vendor_model_cli, beacon_timer);
+
+    vendor_model_work_submit(&cli->beacon_work);
 }
+#endif /* CONFIG_VENDOR_MODEL_NET_TIME */
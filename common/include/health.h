@@ -0,0 +1,35 @@
+#ifndef HEALTH_H
+#define HEALTH_H
+
+#include <zephyr/bluetooth/mesh.h>
+
+/* Vendor specific fault values (0x80-0xff) reported by the Health Server */
+#define HEALTH_FAULT_SEND_BUF_EXHAUSTED 0x80
+#define HEALTH_FAULT_HANDLER_OVERRUN    0x81
+#define HEALTH_FAULT_SUPERSEDED         0x82
+
+/* Number of distinct fault values, sizes the health publication */
+#define HEALTH_FAULT_COUNT 3
+
+/* Running count behind the superseded request fault (0x82) */
+typedef uint32_t (*health_count_get_t)(void);
+
+/* Start periodic fault evaluation, status is published from elem. Each
+ * application supplies what counts as a superseded request; NULL never
+ * raises 0x82.
+ */
+void health_faults_init(const struct bt_mesh_elem *elem,
+                        health_count_get_t superseded_get);
+
+/* Health Server callbacks */
+int health_fault_get_cur(const struct bt_mesh_model *model, uint8_t *test_id,
+                         uint16_t *company_id, uint8_t *faults,
+                         uint8_t *fault_count);
+int health_fault_get_reg(const struct bt_mesh_model *model, uint16_t company_id,
+                         uint8_t *test_id, uint8_t *faults,
+                         uint8_t *fault_count);
+int health_fault_clear(const struct bt_mesh_model *model, uint16_t company_id);
+int health_fault_test(const struct bt_mesh_model *model, uint8_t test_id,
+                      uint16_t company_id);
+
+#endif /* HEALTH_H */
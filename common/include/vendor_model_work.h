@@ -0,0 +1,56 @@
+#ifndef VENDOR_MODEL_WORK_H
+#define VENDOR_MODEL_WORK_H
+
+#include <zephyr/kernel.h>
+
+/* Vendor model work queue, shared by the button client and light server */
+struct vendor_model_work {
+    struct k_work work;
+#if defined(CONFIG_VENDOR_MODEL_STATS)
+    k_work_handler_t handler;
+    uint32_t submit_cyc;
+#endif
+};
+
+struct vendor_model_work_q_stats {
+    uint32_t depth;         /* Items currently queued */
+    uint32_t max_depth;
+    uint32_t processed;
+    uint32_t last_wait_us;  /* Submit to start of handler */
+    uint32_t max_wait_us;
+    uint32_t last_run_us;   /* Start to end of handler */
+    uint32_t max_run_us;
+    uint32_t coalesced;     /* Submits that found the item still queued */
+};
+
+void vendor_model_work_init(struct vendor_model_work *vwork,
+                            k_work_handler_t handler);
+int vendor_model_work_submit(struct vendor_model_work *vwork);
+
+/* Account the result of a vendor model send */
+void vendor_model_send_count(int err);
+
+#if defined(CONFIG_VENDOR_MODEL_STATS)
+void vendor_model_work_q_stats_get(struct vendor_model_work_q_stats *stats);
+/* Restart max_depth, max_wait_us and max_run_us, for periodic sampling */
+void vendor_model_work_q_peak_reset(void);
+
+/* Number of vendor model sends that failed with -ENOBUFS */
+uint32_t vendor_model_send_nobufs_get(void);
+#else
+static inline void vendor_model_work_q_stats_get(struct vendor_model_work_q_stats *stats)
+{
+    *stats = (struct vendor_model_work_q_stats){ 0 };
+}
+
+static inline void vendor_model_work_q_peak_reset(void)
+{
+}
+
+static inline uint32_t vendor_model_send_nobufs_get(void)
+{
+    return 0;
+}
+#endif
+
+#endif /* VENDOR_MODEL_WORK_H */
@@ -0,0 +1,133 @@
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/mesh.h>
+#include "vendor_model.h"
+#include "health.h"
+
+static const uint8_t fault_codes[HEALTH_FAULT_COUNT] = {
+    HEALTH_FAULT_SEND_BUF_EXHAUSTED,
+    HEALTH_FAULT_HANDLER_OVERRUN,
+    HEALTH_FAULT_SUPERSEDED,
+};
+
+static const struct bt_mesh_elem *health_elem;
+static health_count_get_t health_superseded_get;
+
+/* Bit n is set when fault_codes[n] is active */
+static atomic_t cur_faults;
+static atomic_t reg_faults;
+
+/* Counter values at the previous evaluation */
+static uint32_t last_nobufs;
+static uint32_t last_superseded;
+
+static void eval_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(eval_work, eval_work_handler);
+
+static bool over(uint32_t value, uint32_t threshold)
+{
+    /* A threshold of 0 disables the fault */
+    return threshold && value >= threshold;
+}
+
+static void eval_work_handler(struct k_work *work)
+{
+    struct vendor_model_work_q_stats q;
+    uint32_t nobufs = vendor_model_send_nobufs_get();
+    uint32_t superseded = health_superseded_get ? health_superseded_get() : 0;
+    atomic_val_t faults = 0;
+    atomic_val_t prev;
+
+    vendor_model_work_q_stats_get(&q);
+    vendor_model_work_q_peak_reset();
+
+    if (over(nobufs - last_nobufs, CONFIG_HEALTH_FAULT_SEND_BUF_THRESHOLD)) {
+        faults |= BIT(0);
+    }
+    if (over(q.max_run_us, CONFIG_HEALTH_FAULT_OVERRUN_US)) {
+        faults |= BIT(1);
+    }
+    if (over(superseded - last_superseded, CONFIG_HEALTH_FAULT_SUPERSEDED_THRESHOLD)) {
+        faults |= BIT(2);
+    }
+
+    last_nobufs = nobufs;
+    last_superseded = superseded;
+
+    atomic_or(&reg_faults, faults);
+    prev = atomic_set(&cur_faults, faults);
+
+    /* Publish a Current Status as soon as the fault set changes */
+    if (prev != faults && health_elem) {
+        bt_mesh_health_srv_fault_update(health_elem);
+    }
+
+    k_work_reschedule(&eval_work, K_SECONDS(CONFIG_HEALTH_FAULT_PERIOD_S));
+}
+
+static uint8_t faults_fill(atomic_val_t mask, uint8_t *faults, uint8_t max)
+{
+    uint8_t count = 0;
+
+    for (int i = 0; i < HEALTH_FAULT_COUNT && count < max; i++) {
+        if (mask & BIT(i)) {
+            faults[count++] = fault_codes[i];
+        }
+    }
+
+    return count;
+}
+
+int health_fault_get_cur(const struct bt_mesh_model *model, uint8_t *test_id,
+                         uint16_t *company_id, uint8_t *faults,
+                         uint8_t *fault_count)
+{
+    *test_id = 0;
+    *company_id = BT_MESH_VENDOR_COMPANY_ID;
+    *fault_count = faults_fill(atomic_get(&cur_faults), faults, *fault_count);
+
+    return 0;
+}
+
+int health_fault_get_reg(const struct bt_mesh_model *model, uint16_t company_id,
+                         uint8_t *test_id, uint8_t *faults,
+                         uint8_t *fault_count)
+{
+    if (company_id != BT_MESH_VENDOR_COMPANY_ID) {
+        return -EINVAL;
+    }
+
+    *test_id = 0;
+    *fault_count = faults_fill(atomic_get(&reg_faults), faults, *fault_count);
+
+    return 0;
+}
+
+int health_fault_clear(const struct bt_mesh_model *model, uint16_t company_id)
+{
+    if (company_id != BT_MESH_VENDOR_COMPANY_ID) {
+        return -EINVAL;
+    }
+
+    /* Faults that are still active stay registered */
+    atomic_set(&reg_faults, atomic_get(&cur_faults));
+
+    return 0;
+}
+
+int health_fault_test(const struct bt_mesh_model *model, uint8_t test_id,
+                      uint16_t company_id)
+{
+    if (company_id != BT_MESH_VENDOR_COMPANY_ID || test_id != 0) {
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+void health_faults_init(const struct bt_mesh_elem *elem,
+                        health_count_get_t superseded_get)
+{
+    health_elem = elem;
+    health_superseded_get = superseded_get;
+    k_work_reschedule(&eval_work, K_SECONDS(CONFIG_HEALTH_FAULT_PERIOD_S));
+}
@@ -0,0 +1,138 @@
+#include <zephyr/kernel.h>
+#include <zephyr/init.h>
+#include <zephyr/sys/util.h>
+#include "vendor_model_work.h"
+
+#if defined(CONFIG_VENDOR_MODEL_STATS)
+/* Sends that failed for lack of an advertising buffer */
+static atomic_t send_nobufs;
+#endif
+
+void vendor_model_send_count(int err)
+{
+#if defined(CONFIG_VENDOR_MODEL_STATS)
+    if (err == -ENOBUFS) {
+        atomic_inc(&send_nobufs);
+    }
+#endif
+}
+
+/* Dedicated work queue for vendor model actions */
+static K_THREAD_STACK_DEFINE(vendor_work_q_stack,
+                             CONFIG_VENDOR_MODEL_WORK_Q_STACK_SIZE);
+static struct k_work_q vendor_work_q;
+
+#if defined(CONFIG_VENDOR_MODEL_STATS)
+static struct vendor_model_work_q_stats work_q_stats;
+static struct k_spinlock work_q_lock;
+
+static void vendor_work_handler(struct k_work *work)
+{
+    struct vendor_model_work *vwork =
+        CONTAINER_OF(work, struct vendor_model_work, work);
+    uint32_t start_cyc = k_cycle_get_32();
+    uint32_t wait_us = k_cyc_to_us_floor32(start_cyc - vwork->submit_cyc);
+    uint32_t run_us;
+    k_spinlock_key_t key = k_spin_lock(&work_q_lock);
+
+    work_q_stats.depth--;
+    work_q_stats.processed++;
+    work_q_stats.last_wait_us = wait_us;
+    work_q_stats.max_wait_us = MAX(work_q_stats.max_wait_us, wait_us);
+    k_spin_unlock(&work_q_lock, key);
+
+    /* The item may be resubmitted from here on, do not touch it after */
+    vwork->handler(work);
+    run_us = k_cyc_to_us_floor32(k_cycle_get_32() - start_cyc);
+
+    key = k_spin_lock(&work_q_lock);
+    work_q_stats.last_run_us = run_us;
+    work_q_stats.max_run_us = MAX(work_q_stats.max_run_us, run_us);
+    k_spin_unlock(&work_q_lock, key);
+}
+
+void vendor_model_work_init(struct vendor_model_work *vwork,
+                            k_work_handler_t handler)
+{
+    vwork->handler = handler;
+    k_work_init(&vwork->work, vendor_work_handler);
+}
+
+int vendor_model_work_submit(struct vendor_model_work *vwork)
+{
+    bool in_isr = k_is_in_isr();
+    k_spinlock_key_t key;
+    int ret;
+
+    /* Keep the queue thread from picking the item up before it is counted */
+    if (!in_isr) {
+        k_sched_lock();
+    }
+
+    ret = k_work_submit_to_queue(&vendor_work_q, &vwork->work);
+    key = k_spin_lock(&work_q_lock);
+    if (ret > 0) {
+        vwork->submit_cyc = k_cycle_get_32();
+        work_q_stats.depth++;
+        work_q_stats.max_depth = MAX(work_q_stats.max_depth, work_q_stats.depth);
+    } else if (ret == 0) {
+        /* Still queued, the earlier request is superseded */
+        work_q_stats.coalesced++;
+    }
+    k_spin_unlock(&work_q_lock, key);
+
+    if (!in_isr) {
+        k_sched_unlock();
+    }
+
+    return ret;
+}
+
+void vendor_model_work_q_stats_get(struct vendor_model_work_q_stats *stats)
+{
+    k_spinlock_key_t key = k_spin_lock(&work_q_lock);
+
+    *stats = work_q_stats;
+    k_spin_unlock(&work_q_lock, key);
+}
+
+void vendor_model_work_q_peak_reset(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&work_q_lock);
+
+    work_q_stats.max_depth = work_q_stats.depth;
+    work_q_stats.max_wait_us = 0;
+    work_q_stats.max_run_us = 0;
+    k_spin_unlock(&work_q_lock, key);
+}
+
+uint32_t vendor_model_send_nobufs_get(void)
+{
+    return atomic_get(&send_nobufs);
+}
+#else
+void vendor_model_work_init(struct vendor_model_work *vwork,
+                            k_work_handler_t handler)
+{
+    k_work_init(&vwork->work, handler);
+}
+
+int vendor_model_work_submit(struct vendor_model_work *vwork)
+{
+    return k_work_submit_to_queue(&vendor_work_q, &vwork->work);
+}
+#endif /* CONFIG_VENDOR_MODEL_STATS */
+
+static int vendor_work_q_init(void)
+{
+    const struct k_work_queue_config cfg = {
+        .name = "vendor_wq",
+    };
+
+    k_work_queue_start(&vendor_work_q, vendor_work_q_stack,
+                       K_THREAD_STACK_SIZEOF(vendor_work_q_stack),
+                       CONFIG_VENDOR_MODEL_WORK_Q_PRIORITY, &cfg);
+    return 0;
+}
+
+SYS_INIT(vendor_work_q_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
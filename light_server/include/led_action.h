@@ -0,0 +1,14 @@
+#ifndef LED_ACTION_H
+#define LED_ACTION_H
+
+#include "vendor_model.h"
+
+/* Vendor server whose handlers drive the LEDs from the vendor model work
+ * queue. Shared by the light server and the trace replay, so a replay runs
+ * the same actuation and response path as the field build.
+ */
+extern struct bt_mesh_vendor_model_srv vendor_server;
+
+void led_action_init(void);
+
+#endif /* LED_ACTION_H */
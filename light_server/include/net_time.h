@@ -0,0 +1,30 @@
+#ifndef NET_TIME_H
+#define NET_TIME_H
+
+#include <zephyr/kernel.h>
+#include "vendor_model.h"
+
+/* Local clock in microseconds, wraps after ~71 minutes */
+uint32_t net_time_local_us(void);
+
+/* The network time is the uptime of the client sending the beacons, so it
+ * is tracked separately for every beacon source address.
+ */
+
+/* Feed a time beacon received from addr, rx_us is the local time of
+ * reception
+ */
+void net_time_beacon_rx(uint16_t addr, const struct time_beacon *beacon,
+                        uint8_t recv_ttl, uint32_t rx_us);
+
+/* Whether the network time of addr is known, false for unknown sources */
+bool net_time_synced(uint16_t addr);
+
+/* Local time left until network time net_us of addr, 0 when it passed less than
+ * CONFIG_VENDOR_MODEL_NET_TIME_MAX_LATE_MS ago. Returns -EAGAIN when not
+ * synchronized to addr, -ETIME when net_us passed longer ago and -ERANGE when it
+ * is more than CONFIG_VENDOR_MODEL_NET_TIME_MAX_DELAY_MS in the future.
+ */
+int net_time_until(uint16_t addr, uint32_t net_us, uint32_t *delay_us);
+
+#endif /* NET_TIME_H */
@@ -0,0 +1,48 @@
+#ifndef PDU_TRACE_H__
+#define PDU_TRACE_H__
+
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/mesh.h>
+
+/* Trace record, little-endian, followed by len payload bytes. The same
+ * layout is written to the RTT channel and read by scripts/pdu_trace.py
+ * and the replay application.
+ */
+struct pdu_trace_hdr {
+    uint8_t len;            /* Payload bytes that follow */
+    uint8_t flags;          /* PDU_TRACE_F_* */
+    uint8_t ttl;            /* Received TTL, or the TTL sent with */
+    int8_t rssi;            /* RX only, 0 for TX */
+    uint16_t src;           /* 0x0000 (this node) for TX */
+    uint16_t dst;
+    uint32_t opcode;        /* Gap records: number of records lost */
+    uint32_t timestamp_us;  /* Local uptime, wraps */
+} __packed;
+
+#define PDU_TRACE_F_TX        BIT(0)
+#define PDU_TRACE_F_TRUNCATED BIT(1)  /* Payload longer than stored */
+#define PDU_TRACE_F_SEND_ERR  BIT(2)  /* bt_mesh_model_send() failed */
+#define PDU_TRACE_F_GAP       BIT(3)  /* Records overwritten before drain */
+
+#if defined(CONFIG_VENDOR_MODEL_TRACE)
+/* Call before pulling anything from buf */
+void pdu_trace_rx(uint32_t opcode, const struct bt_mesh_msg_ctx *ctx,
+                  const struct net_buf_simple *buf);
+/* msg as passed to bt_mesh_model_send(), opcode included */
+void pdu_trace_tx(uint32_t opcode, const struct bt_mesh_msg_ctx *ctx,
+                  const struct net_buf_simple *msg, int err);
+#else
+static inline void pdu_trace_rx(uint32_t opcode,
+                                const struct bt_mesh_msg_ctx *ctx,
+                                const struct net_buf_simple *buf)
+{
+}
+
+static inline void pdu_trace_tx(uint32_t opcode,
+                                const struct bt_mesh_msg_ctx *ctx,
+                                const struct net_buf_simple *msg, int err)
+{
+}
+#endif
+
+#endif /* PDU_TRACE_H__ */
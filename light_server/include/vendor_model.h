@@ -1,7 +1,9 @@
 #ifndef VENDOR_MODEL_H__
 #define VENDOR_MODEL_H__
 
+#include <zephyr/kernel.h>
 #include <zephyr/bluetooth/mesh.h>
+#include "vendor_model_work.h"
 
 /* Company ID and Model IDs */
 #define BT_MESH_VENDOR_COMPANY_ID    0x0059 /* Nordic Semiconductor ASA */
@@ -13,9 +15,11 @@
 #define BT_MESH_VENDOR_OP_LED_GET     BT_MESH_MODEL_OP_3(0x01, BT_MESH_VENDOR_COMPANY_ID)
 #define BT_MESH_VENDOR_OP_LED_STATUS  BT_MESH_MODEL_OP_3(0x02, BT_MESH_VENDOR_COMPANY_ID)
 #define BT_MESH_VENDOR_OP_BUTTON_PRESS BT_MESH_MODEL_OP_3(0x03, BT_MESH_VENDOR_COMPANY_ID)
+#define BT_MESH_VENDOR_OP_TIME_BEACON BT_MESH_MODEL_OP_3(0x04, BT_MESH_VENDOR_COMPANY_ID)
+#define BT_MESH_VENDOR_OP_LED_SET_AT  BT_MESH_MODEL_OP_3(0x05, BT_MESH_VENDOR_COMPANY_ID)
 
 /* Maximum message length */
-#define BT_MESH_VENDOR_MSG_MAXLEN_MESSAGE 4
+#define BT_MESH_VENDOR_MSG_MAXLEN_MESSAGE 6
 
 /* LED states */
 #define LED_OFF 0x00
@@ -36,6 +40,13 @@ struct button_press {
     uint8_t button_state;
 };
 
+/* Time beacon from the network time reference (the button client) */
+struct time_beacon {
+    uint8_t seq;
+    uint8_t ttl;            /* TTL the beacon was sent with */
+    uint32_t prev_tx_us;    /* TX time of beacon seq - 1, 0 if unknown */
+};
+
 /* Forward declarations */
 struct bt_mesh_vendor_model_cli;
 struct bt_mesh_vendor_model_srv;
@@ -43,6 +54,7 @@ struct bt_mesh_vendor_model_srv;
 /* Operation arrays for the models */
 extern const struct bt_mesh_model_op vendor_srv_op[];
 extern const struct bt_mesh_model_op vendor_cli_op[];
+extern const struct bt_mesh_model_cb vendor_srv_cb;
 
 /* Vendor Model Client API */
 struct bt_mesh_vendor_model_cli_handlers {
@@ -68,14 +80,30 @@ struct bt_mesh_vendor_model_srv_handlers {
     void (*button_pressed)(struct bt_mesh_vendor_model_srv *srv,
                           struct bt_mesh_msg_ctx *ctx,
                           struct button_press *press);
+    /* LED Set At, delay_us is the local time left until the requested
+     * network time (0 when it has just passed or the clock is not
+     * synced). Stale and out of range requests never get here.
+     */
+    void (*led_set_at)(struct bt_mesh_vendor_model_srv *srv,
+                      struct bt_mesh_msg_ctx *ctx,
+                      uint8_t led_index,
+                      uint8_t led_state,
+                      uint32_t delay_us);
 };
 
 struct bt_mesh_vendor_model_srv {
-    struct bt_mesh_model *model;
+    const struct bt_mesh_model *model;
     struct bt_mesh_vendor_model_srv_handlers handlers;
     uint8_t led_states[4];  /* State storage for 4 LEDs */
 };
 
+/* Console messages from the vendor model handlers */
+#if defined(CONFIG_VENDOR_MODEL_LOG)
+#define VENDOR_MODEL_PRINTK(...) printk(__VA_ARGS__)
+#else
+#define VENDOR_MODEL_PRINTK(...)
+#endif
+
 /* Helper macros */
 #define BT_MESH_VENDOR_MODEL_CLI_DEFINE(_name, _handlers) \
     static struct bt_mesh_vendor_model_cli _name = { \
@@ -0,0 +1,261 @@
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/bluetooth/mesh.h>
+#include <posix_board_if.h>
+#include <dk_buttons_and_leds.h>
+#include "vendor_model.h"
+#include "led_action.h"
+#include "pdu_trace.h"
+
+/* Raw capture from the RTT trace channel, embedded at build time */
+static const uint8_t trace[] = {
+#include "pdu_trace.inc"
+};
+
+/* Time left after the last record for actuations still on the work queue
+ * or waiting on an LED Set At timer
+ */
+#if defined(CONFIG_VENDOR_MODEL_NET_TIME)
+#define REPLAY_DRAIN_MS (CONFIG_VENDOR_MODEL_NET_TIME_MAX_DELAY_MS + 100)
+#else
+#define REPLAY_DRAIN_MS 100
+#endif
+
+/* The light server's own handlers, so LED Status goes out from the same
+ * deferred actuation path as in the field.
+ */
+static const struct bt_mesh_model model = {
+    .user_data = &vendor_server,
+};
+
+static struct {
+    uint32_t rx;
+    uint32_t rx_skipped;    /* Unknown opcode, bad length or truncated */
+    uint32_t tx;
+    uint32_t tx_match;
+    uint32_t tx_mismatch;
+    uint32_t tx_missing;    /* Recorded but never sent by the replay */
+    uint32_t lost;
+} replay_stats;
+
+/* Offset of the next recorded TX to compare a replayed send against */
+static size_t next_tx;
+
+static uint32_t replay_time_us(void)
+{
+    return (uint32_t)k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+static const struct pdu_trace_hdr *record_at(size_t off)
+{
+    const struct pdu_trace_hdr *hdr = (const void *)&trace[off];
+
+    if (off + sizeof(*hdr) > sizeof(trace) ||
+        off + sizeof(*hdr) + hdr->len > sizeof(trace)) {
+        return NULL;
+    }
+
+    return hdr;
+}
+
+static const struct pdu_trace_hdr *recorded_tx_next(void)
+{
+    const struct pdu_trace_hdr *hdr;
+
+    while ((hdr = record_at(next_tx))) {
+        next_tx += sizeof(*hdr) + hdr->len;
+        if (hdr->flags & PDU_TRACE_F_TX) {
+            return hdr;
+        }
+    }
+
+    return NULL;
+}
+
+static void payload_print(const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        printk(" %02x", data[i]);
+    }
+    printk("\n");
+}
+
+static bool tx_matches(const struct pdu_trace_hdr *rec, uint16_t addr,
+                       uint32_t opcode, const uint8_t *payload, size_t len)
+{
+    if (!rec || sys_le16_to_cpu(rec->dst) != addr ||
+        sys_le32_to_cpu(rec->opcode) != opcode) {
+        return false;
+    }
+
+    /* Only the first rec->len bytes of a truncated payload were kept */
+    if (rec->flags & PDU_TRACE_F_TRUNCATED) {
+        return len > rec->len && !memcmp(rec + 1, payload, rec->len);
+    }
+
+    return len == rec->len && !memcmp(rec + 1, payload, len);
+}
+
+/* Board stub, the LED state is visible in the LED Status sent after it */
+int dk_set_led(uint8_t led_idx, uint32_t val)
+{
+    printk("%10u LED %u %s\n", replay_time_us(), led_idx, val ? "on" : "off");
+
+    return 0;
+}
+
+/* Mesh stack stubs */
+void bt_mesh_model_msg_init(struct net_buf_simple *msg, uint32_t opcode)
+{
+    net_buf_simple_init(msg, 0);
+
+    if (opcode < 0x100) {
+        net_buf_simple_add_u8(msg, opcode);
+    } else if (opcode < 0x10000) {
+        net_buf_simple_add_be16(msg, opcode);
+    } else {
+        net_buf_simple_add_u8(msg, opcode >> 16);
+        net_buf_simple_add_le16(msg, opcode & 0xffff);
+    }
+}
+
+int bt_mesh_model_send(const struct bt_mesh_model *mod,
+                       struct bt_mesh_msg_ctx *ctx,
+                       struct net_buf_simple *msg,
+                       const struct bt_mesh_send_cb *cb, void *cb_data)
+{
+    const struct pdu_trace_hdr *rec = recorded_tx_next();
+    uint32_t opcode;
+    const uint8_t *payload;
+    size_t len;
+
+    /* Every vendor opcode is three bytes, encoded by the stub above */
+    __ASSERT_NO_MSG(msg->len >= 3);
+    opcode = ((uint32_t)msg->data[0] << 16) | sys_get_le16(&msg->data[1]);
+    payload = msg->data + 3;
+    len = msg->len - 3;
+
+    replay_stats.tx++;
+    printk("%10u TX -> 0x%04x op 0x%06x:", replay_time_us(), ctx->addr, opcode);
+    payload_print(payload, len);
+
+    if (tx_matches(rec, ctx->addr, opcode, payload, len)) {
+        replay_stats.tx_match++;
+    } else {
+        printk("           TX differs from the recorded one\n");
+        replay_stats.tx_mismatch++;
+    }
+
+    if (cb && cb->start) {
+        cb->start(0, 0, cb_data);
+    }
+    if (cb && cb->end) {
+        cb->end(0, cb_data);
+    }
+
+    return 0;
+}
+
+static const struct bt_mesh_model_op *op_find(uint32_t opcode)
+{
+    for (const struct bt_mesh_model_op *op = vendor_srv_op; op->func; op++) {
+        if (op->opcode == opcode) {
+            return op;
+        }
+    }
+
+    return NULL;
+}
+
+static void replay_rx(const struct pdu_trace_hdr *hdr)
+{
+    const struct bt_mesh_model_op *op = op_find(sys_le32_to_cpu(hdr->opcode));
+    NET_BUF_SIMPLE_DEFINE(buf, UINT8_MAX);
+    struct bt_mesh_msg_ctx ctx = {
+        .addr = sys_le16_to_cpu(hdr->src),
+        .recv_dst = sys_le16_to_cpu(hdr->dst),
+        .recv_ttl = hdr->ttl,
+        .recv_rssi = hdr->rssi,
+        .send_ttl = BT_MESH_TTL_DEFAULT,
+    };
+
+    printk("%10u RX 0x%04x -> 0x%04x op 0x%06x ttl %u rssi %d:",
+           replay_time_us(), ctx.addr, ctx.recv_dst,
+           sys_le32_to_cpu(hdr->opcode), ctx.recv_ttl, ctx.recv_rssi);
+    payload_print((const uint8_t *)(hdr + 1), hdr->len);
+
+    /* Same length checks as the access layer */
+    if (!op || (hdr->flags & PDU_TRACE_F_TRUNCATED) ||
+        (op->len >= 0 && hdr->len < op->len) ||
+        (op->len < 0 && hdr->len != -op->len)) {
+        printk("           skipped\n");
+        replay_stats.rx_skipped++;
+        return;
+    }
+
+    net_buf_simple_add_mem(&buf, hdr + 1, hdr->len);
+    replay_stats.rx++;
+    op->func(&model, &ctx, &buf);
+}
+
+int main(void)
+{
+    const struct pdu_trace_hdr *hdr;
+    uint64_t start_us = k_ticks_to_us_floor64(k_uptime_ticks());
+    uint64_t elapsed_us = 0;
+    uint32_t last_us = 0;
+    bool first = true;
+    size_t off = 0;
+
+    led_action_init();
+    vendor_srv_cb.init(&model);
+
+    printk("Replaying %zu bytes of vendor model trace\n", sizeof(trace));
+
+    while ((hdr = record_at(off))) {
+        off += sizeof(*hdr) + hdr->len;
+
+        if (hdr->flags & PDU_TRACE_F_GAP) {
+            /* Stamped at drain time, not in sequence with the records */
+            printk("           %u records lost\n", sys_le32_to_cpu(hdr->opcode));
+            replay_stats.lost += sys_le32_to_cpu(hdr->opcode);
+            continue;
+        }
+
+        /* Keep the recorded spacing so timers and the network time
+         * estimate see the same intervals as in the field.
+         */
+        if (!first) {
+            elapsed_us += (uint32_t)(sys_le32_to_cpu(hdr->timestamp_us) - last_us);
+        }
+        last_us = sys_le32_to_cpu(hdr->timestamp_us);
+        first = false;
+        k_sleep(K_TIMEOUT_ABS_US(start_us + elapsed_us));
+
+        if (!(hdr->flags & PDU_TRACE_F_TX)) {
+            replay_rx(hdr);
+        }
+    }
+
+    if (off != sizeof(trace)) {
+        printk("Trace ends with a partial record (%zu bytes)\n",
+               sizeof(trace) - off);
+    }
+
+    k_sleep(K_MSEC(REPLAY_DRAIN_MS));
+
+    while (recorded_tx_next()) {
+        replay_stats.tx_missing++;
+    }
+
+    printk("RX replayed %u, skipped %u, lost in capture %u\n",
+           replay_stats.rx, replay_stats.rx_skipped, replay_stats.lost);
+    printk("TX sent %u, matching %u, differing %u, missing %u\n",
+           replay_stats.tx, replay_stats.tx_match, replay_stats.tx_mismatch,
+           replay_stats.tx_missing);
+
+    posix_exit(replay_stats.tx_mismatch || replay_stats.tx_missing ? 1 : 0);
+
+    return 0;
+}
@@ -0,0 +1,161 @@
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/mesh.h>
+#include <dk_buttons_and_leds.h>
+#include "vendor_model.h"
+#include "led_action.h"
+
+/* Pending LED actuation, one slot per LED. A set that arrives before the
+ * previous one for the same LED was applied simply replaces it.
+ */
+struct led_action {
+    struct vendor_model_work work;
+    struct k_timer timer;   /* Pending LED Set At */
+    struct bt_mesh_vendor_model_srv *srv;
+    struct bt_mesh_msg_ctx ctx;
+    uint8_t led_index;
+    uint8_t led_state;
+};
+
+static struct led_action led_actions[4];
+static struct k_spinlock led_action_lock;
+
+static void led_action_work_handler(struct k_work *work)
+{
+    struct vendor_model_work *vwork =
+        CONTAINER_OF(work, struct vendor_model_work, work);
+    struct led_action *action = CONTAINER_OF(vwork, struct led_action, work);
+    struct bt_mesh_msg_ctx ctx;
+    struct led_status status;
+    k_spinlock_key_t key;
+
+    key = k_spin_lock(&led_action_lock);
+    ctx = action->ctx;
+    status.led_index = action->led_index;
+    status.led_state = action->led_state;
+    k_spin_unlock(&led_action_lock, key);
+
+    /* Set the physical LED state. The stored state follows the LED, so
+     * an LED Get never reports a set that has not been applied yet.
+     */
+    dk_set_led(status.led_index, status.led_state == LED_ON);
+    action->srv->led_states[status.led_index] = status.led_state;
+
+    /* Send status back */
+    bt_mesh_vendor_model_srv_led_status_send(action->srv, &ctx, &status);
+
+    VENDOR_MODEL_PRINTK("LED %d set to %s\n", status.led_index,
+           status.led_state == LED_ON ? "ON" : "OFF");
+}
+
+static void led_action_timeout(struct k_timer *timer)
+{
+    struct led_action *action = CONTAINER_OF(timer, struct led_action, timer);
+
+    vendor_model_work_submit(&action->work);
+}
+
+static struct led_action *led_action_prepare(struct bt_mesh_vendor_model_srv *srv,
+                                             struct bt_mesh_msg_ctx *ctx,
+                                             uint8_t led_index,
+                                             uint8_t led_state)
+{
+    struct led_action *action = &led_actions[led_index];
+    k_spinlock_key_t key;
+
+    /* A newer request replaces a timed one that has not fired yet */
+    k_timer_stop(&action->timer);
+
+    key = k_spin_lock(&led_action_lock);
+    action->srv = srv;
+    action->ctx = *ctx;
+    action->led_index = led_index;
+    action->led_state = led_state;
+    k_spin_unlock(&led_action_lock, key);
+
+    return action;
+}
+
+static void led_set_handler(struct bt_mesh_vendor_model_srv *srv,
+                          struct bt_mesh_msg_ctx *ctx,
+                          uint8_t led_index,
+                          uint8_t led_state)
+{
+    struct led_action *action;
+
+    if (led_index >= 4) {
+        return;
+    }
+
+    /* Actuate and respond from the vendor model work queue */
+    action = led_action_prepare(srv, ctx, led_index, led_state);
+    vendor_model_work_submit(&action->work);
+}
+
+#if defined(CONFIG_VENDOR_MODEL_NET_TIME)
+static void led_set_at_handler(struct bt_mesh_vendor_model_srv *srv,
+                             struct bt_mesh_msg_ctx *ctx,
+                             uint8_t led_index,
+                             uint8_t led_state,
+                             uint32_t delay_us)
+{
+    struct led_action *action;
+
+    if (led_index >= 4) {
+        return;
+    }
+
+    action = led_action_prepare(srv, ctx, led_index, led_state);
+    if (!delay_us) {
+        vendor_model_work_submit(&action->work);
+        return;
+    }
+
+    /* Switch at the requested network time, in step with the other nodes */
+    k_timer_start(&action->timer, K_USEC(delay_us), K_NO_WAIT);
+}
+#endif
+
+static void led_get_handler(struct bt_mesh_vendor_model_srv *srv,
+                          struct bt_mesh_msg_ctx *ctx,
+                          uint8_t led_index)
+{
+    if (led_index >= 4) {
+        return;
+    }
+
+    struct led_status status = {
+        .led_index = led_index,
+        .led_state = srv->led_states[led_index]
+    };
+    bt_mesh_vendor_model_srv_led_status_send(srv, ctx, &status);
+
+    VENDOR_MODEL_PRINTK("LED %d state requested\n", led_index);
+}
+
+static void button_handler(struct bt_mesh_vendor_model_srv *srv,
+                         struct bt_mesh_msg_ctx *ctx,
+                         struct button_press *press)
+{
+    VENDOR_MODEL_PRINTK("Button %d %s\n", 
+           press->button_index,
+           press->button_state == BUTTON_PRESSED ? "pressed" : "released");
+}
+
+struct bt_mesh_vendor_model_srv vendor_server = {
+    .handlers = {
+        .led_set = led_set_handler,
+        .led_get = led_get_handler,
+        .button_pressed = button_handler,
+#if defined(CONFIG_VENDOR_MODEL_NET_TIME)
+        .led_set_at = led_set_at_handler,
+#endif
+    },
+};
+
+void led_action_init(void)
+{
+    for (int i = 0; i < ARRAY_SIZE(led_actions); i++) {
+        vendor_model_work_init(&led_actions[i].work, led_action_work_handler);
+        k_timer_init(&led_actions[i].timer, led_action_timeout, NULL);
+    }
+}
@@ -1,79 +1,62 @@
+#include <zephyr/kernel.h>
 #include <zephyr/bluetooth/bluetooth.h>
 #include <zephyr/bluetooth/mesh.h>
+#include <zephyr/drivers/hwinfo.h>
 #include <dk_buttons_and_leds.h>
 #include "vendor_model.h"
 #include "device_config.h"
+#include "health.h"
+#include "led_action.h"
 
 #define LED_MSG "LED state changed\n"
 
-static void led_set_handler(struct bt_mesh_vendor_model_srv *srv,
-                          struct bt_mesh_msg_ctx *ctx,
-                          uint8_t led_index,
-                          uint8_t led_state)
+/* Attention: blink all LEDs until the timer expires */
+static void attention_blink(struct k_timer *timer)
 {
-    if (led_index >= 4) {
-        return;
-    }
+    static bool on;
 
-    /* Set the physical LED state */
-    dk_set_led(led_index, led_state == LED_ON);
-    
-    /* Store state */
-    srv->led_states[led_index] = led_state;
-    
-    /* Send status back */
-    struct led_status status = {
-        .led_index = led_index,
-        .led_state = led_state
-    };
-    bt_mesh_vendor_model_srv_led_status_send(srv, ctx, &status);
-
-    printk("LED %d set to %s\n", led_index, led_state == LED_ON ? "ON" : "OFF");
+    on = !on;
+    dk_set_leds(on ? DK_ALL_LEDS_MSK : DK_NO_LEDS_MSK);
 }
 
-static void led_get_handler(struct bt_mesh_vendor_model_srv *srv,
-                          struct bt_mesh_msg_ctx *ctx,
-                          uint8_t led_index)
-{
-    if (led_index >= 4) {
-        return;
-    }
+static K_TIMER_DEFINE(attention_timer, attention_blink, NULL);
 
-    struct led_status status = {
-        .led_index = led_index,
-        .led_state = srv->led_states[led_index]
-    };
-    bt_mesh_vendor_model_srv_led_status_send(srv, ctx, &status);
-
-    printk("LED %d state requested\n", led_index);
+static void attention_on(const struct bt_mesh_model *model)
+{
+    k_timer_start(&attention_timer, K_NO_WAIT, K_MSEC(250));
 }
 
-static void button_handler(struct bt_mesh_vendor_model_srv *srv,
-                         struct bt_mesh_msg_ctx *ctx,
-                         struct button_press *press)
+static void attention_off(const struct bt_mesh_model *model)
 {
-    printk("Button %d %s\n", 
-           press->button_index,
-           press->button_state == BUTTON_PRESSED ? "pressed" : "released");
+    k_timer_stop(&attention_timer);
+
+    /* Restore the LED states */
+    for (int i = 0; i < 4; i++) {
+        dk_set_led(i, vendor_server.led_states[i] == LED_ON);
+    }
 }
 
-/* Define server handlers */
-static const struct bt_mesh_vendor_model_srv_handlers srv_handlers = {
-    .led_set = led_set_handler,
-    .led_get = led_get_handler,
-    .button_pressed = button_handler,
-};
+/* Health Server */
 
-/* Define server model */
-BT_MESH_VENDOR_MODEL_SRV_DEFINE(vendor_server, srv_handlers);
+/* LED Set requests replaced before their actuation ran */
+static uint32_t led_superseded_get(void)
+{
+    struct vendor_model_work_q_stats q;
+
+    vendor_model_work_q_stats_get(&q);
+    return q.coalesced;
+}
 
-/* Health Server */
 struct bt_mesh_health_srv_cb health_srv_cb = {
-    .attn_on = NULL,
-    .attn_off = NULL,
+    .fault_get_cur = health_fault_get_cur,
+    .fault_get_reg = health_fault_get_reg,
+    .fault_clear = health_fault_clear,
+    .fault_test = health_fault_test,
+    .attn_on = attention_on,
+    .attn_off = attention_off,
 };
 
-BT_MESH_HEALTH_PUB_DEFINE(health_pub, 0);
+BT_MESH_HEALTH_PUB_DEFINE(health_pub, HEALTH_FAULT_COUNT);
 struct bt_mesh_health_srv health_srv = {
     .cb = &health_srv_cb,
 };
@@ -82,11 +65,12 @@ struct bt_mesh_health_srv health_srv = {
 static struct bt_mesh_model models[] = {
     BT_MESH_MODEL_CFG_SRV,
     BT_MESH_MODEL_HEALTH_SRV(&health_srv, &health_pub),
-    BT_MESH_VND_MODEL(BT_MESH_VENDOR_COMPANY_ID,
-                      BT_MESH_VENDOR_MODEL_ID_SRV,
-                      vendor_srv_op,
-                      NULL,
-                      &vendor_server)
+    BT_MESH_MODEL_VND_CB(BT_MESH_VENDOR_COMPANY_ID,
+                         BT_MESH_VENDOR_MODEL_ID_SRV,
+                         vendor_srv_op,
+                         NULL,
+                         &vendor_server,
+                         &vendor_srv_cb)
 };
 
 static struct bt_mesh_elem elements[] = {
@@ -135,6 +119,8 @@ static void bt_ready(int err)
     }
 
     printk("Mesh initialized\n");
+
+    health_faults_init(&elements[0], led_superseded_get);
 }
 
 void main(void)
@@ -150,6 +136,13 @@ void main(void)
         return;
     }
 
+    led_action_init();
+
+    /* Keep the 0xdddd prefix and make the rest of the UUID unique per board,
+     * so a provisioner can tell light servers apart.
+     */
+    hwinfo_get_device_id(dev_uuid + 2, sizeof(dev_uuid) - 2);
+
     /* Initialize Bluetooth */
     err = bt_enable(bt_ready);
     if (err) {
@@ -0,0 +1,170 @@
+#include <zephyr/kernel.h>
+#include "vendor_model.h"
+#include "net_time.h"
+
+#define WINDOW CONFIG_VENDOR_MODEL_NET_TIME_WINDOW
+
+/* Offset estimation works like a two-step PTP sync: beacon N reports when
+ * beacon N-1 actually went on air, which is paired with the local time
+ * beacon N-1 was received. Each relay hop adds at least a fixed delay
+ * that is subtracted using the TTL difference. Queuing and retransmissions
+ * only ever make a sample later, so the smallest offset in the window is
+ * the best estimate.
+ *
+ * The network time is the sending client's own uptime, so every client
+ * that sends beacons is a separate clock with its own offset.
+ */
+struct net_time_src {
+    uint16_t addr;          /* Beacon source, unassigned when free */
+    bool have_last;
+    uint8_t last_seq;
+    uint8_t last_hops;
+    uint32_t last_rx_us;
+    int32_t samples[WINDOW];
+    uint8_t sample_count;
+    uint8_t next;
+    int32_t offset_us;      /* Local time minus network time */
+    int64_t synced_at;      /* Uptime (ms) of the last sample */
+    int64_t seen_at;        /* Uptime (ms) of the last beacon */
+};
+
+static struct net_time_src sources[CONFIG_VENDOR_MODEL_NET_TIME_SOURCES];
+static struct k_spinlock nt_lock;
+
+uint32_t net_time_local_us(void)
+{
+    return (uint32_t)k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+/* Called with nt_lock held */
+static struct net_time_src *src_find(uint16_t addr)
+{
+    for (int i = 0; i < ARRAY_SIZE(sources); i++) {
+        if (sources[i].addr == addr) {
+            return &sources[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* Called with nt_lock held. Reuses the source heard from least recently
+ * when the table is full.
+ */
+static struct net_time_src *src_alloc(uint16_t addr)
+{
+    struct net_time_src *src = &sources[0];
+
+    for (int i = 0; i < ARRAY_SIZE(sources); i++) {
+        if (sources[i].addr == BT_MESH_ADDR_UNASSIGNED) {
+            src = &sources[i];
+            break;
+        }
+        if (sources[i].seen_at < src->seen_at) {
+            src = &sources[i];
+        }
+    }
+
+    *src = (struct net_time_src){ .addr = addr };
+    return src;
+}
+
+/* Called with nt_lock held */
+static bool src_synced(const struct net_time_src *src)
+{
+    return src && src->synced_at &&
+           k_uptime_get() - src->synced_at < CONFIG_VENDOR_MODEL_NET_TIME_VALID_S * MSEC_PER_SEC;
+}
+
+void net_time_beacon_rx(uint16_t addr, const struct time_beacon *beacon,
+                        uint8_t recv_ttl, uint32_t rx_us)
+{
+    uint8_t hops = beacon->ttl > recv_ttl ? beacon->ttl - recv_ttl : 0;
+    k_spinlock_key_t key = k_spin_lock(&nt_lock);
+    struct net_time_src *src = src_find(addr);
+
+    if (!src) {
+        src = src_alloc(addr);
+    }
+
+    if (src->have_last && beacon->prev_tx_us &&
+        beacon->seq == (uint8_t)(src->last_seq + 1)) {
+        int32_t sample = (int32_t)(src->last_rx_us - beacon->prev_tx_us) -
+                         src->last_hops * CONFIG_VENDOR_MODEL_NET_TIME_HOP_DELAY_US;
+
+        src->samples[src->next] = sample;
+        src->next = (src->next + 1) % WINDOW;
+        src->sample_count = MIN(src->sample_count + 1, WINDOW);
+
+        src->offset_us = src->samples[0];
+        for (int i = 1; i < src->sample_count; i++) {
+            /* Compare as differences, the clocks wrap */
+            if ((int32_t)((uint32_t)src->samples[i] - (uint32_t)src->offset_us) < 0) {
+                src->offset_us = src->samples[i];
+            }
+        }
+
+        src->synced_at = k_uptime_get();
+    }
+
+    src->have_last = true;
+    src->last_seq = beacon->seq;
+    src->last_hops = hops;
+    src->last_rx_us = rx_us;
+    src->seen_at = k_uptime_get();
+
+    k_spin_unlock(&nt_lock, key);
+}
+
+bool net_time_synced(uint16_t addr)
+{
+    k_spinlock_key_t key = k_spin_lock(&nt_lock);
+    bool synced = src_synced(src_find(addr));
+
+    k_spin_unlock(&nt_lock, key);
+    return synced;
+}
+
+int net_time_until(uint16_t addr, uint32_t net_us, uint32_t *delay_us)
+{
+    const int32_t max_ahead_us =
+        (int32_t)(CONFIG_VENDOR_MODEL_NET_TIME_MAX_DELAY_MS * USEC_PER_MSEC);
+    const int32_t max_late_us =
+        (int32_t)(CONFIG_VENDOR_MODEL_NET_TIME_MAX_LATE_MS * USEC_PER_MSEC);
+    k_spinlock_key_t key;
+    struct net_time_src *src;
+    int32_t offset_us;
+    int32_t delay;
+
+    /* The offset is written from the mesh RX thread, and the 64-bit
+     * synced_at can tear when read without the lock.
+     */
+    key = k_spin_lock(&nt_lock);
+    src = src_find(addr);
+    if (!src_synced(src)) {
+        k_spin_unlock(&nt_lock, key);
+        return -EAGAIN;
+    }
+    offset_us = src->offset_us;
+    k_spin_unlock(&nt_lock, key);
+
+    /* Signed difference, both clocks wrap */
+    delay = (int32_t)(net_us + offset_us - net_time_local_us());
+
+    if (delay < 0) {
+        /* Delivered late: catch up now, unless it is too stale to matter */
+        if (delay < -max_late_us) {
+            return -ETIME;
+        }
+
+        *delay_us = 0;
+        return 0;
+    }
+
+    if (delay > max_ahead_us) {
+        return -ERANGE;
+    }
+
+    *delay_us = delay;
+    return 0;
+}
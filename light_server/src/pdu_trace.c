@@ -0,0 +1,167 @@
+#include <zephyr/kernel.h>
+#include <zephyr/init.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/ring_buffer.h>
+#include <SEGGER_RTT.h>
+#include "pdu_trace.h"
+
+#define PAYLOAD_MAX CONFIG_VENDOR_MODEL_TRACE_PAYLOAD_MAX
+#define RECORD_MAX  (sizeof(struct pdu_trace_hdr) + PAYLOAD_MAX)
+#define RTT_CHANNEL CONFIG_VENDOR_MODEL_TRACE_RTT_CHANNEL
+
+BUILD_ASSERT(CONFIG_VENDOR_MODEL_TRACE_BUF_SIZE >= RECORD_MAX,
+             "Trace buffer cannot hold a single record");
+
+RING_BUF_DECLARE(trace_ring, CONFIG_VENDOR_MODEL_TRACE_BUF_SIZE);
+static struct k_spinlock trace_lock;
+/* Records overwritten since the last gap record went out */
+static uint32_t lost;
+
+static uint8_t rtt_buf[CONFIG_VENDOR_MODEL_TRACE_RTT_BUF_SIZE];
+
+static void trace_drain(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(drain_work, trace_drain);
+
+static uint32_t trace_time_us(void)
+{
+    return (uint32_t)k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+static size_t opcode_len(uint32_t opcode)
+{
+    if (opcode < 0x100) {
+        return 1;
+    }
+
+    return opcode < 0x10000 ? 2 : 3;
+}
+
+/* Called with trace_lock held */
+static void drop_oldest(void)
+{
+    struct pdu_trace_hdr hdr;
+
+    ring_buf_get(&trace_ring, (uint8_t *)&hdr, sizeof(hdr));
+    ring_buf_get(&trace_ring, NULL, hdr.len);
+    lost++;
+}
+
+static void record(struct pdu_trace_hdr *hdr, const uint8_t *data, size_t len)
+{
+    k_spinlock_key_t key;
+
+    if (len > PAYLOAD_MAX) {
+        len = PAYLOAD_MAX;
+        hdr->flags |= PDU_TRACE_F_TRUNCATED;
+    }
+
+    hdr->len = len;
+    hdr->timestamp_us = sys_cpu_to_le32(trace_time_us());
+
+    /* Under load the newest records are the interesting ones */
+    key = k_spin_lock(&trace_lock);
+    while (ring_buf_space_get(&trace_ring) < sizeof(*hdr) + len) {
+        drop_oldest();
+    }
+
+    ring_buf_put(&trace_ring, (const uint8_t *)hdr, sizeof(*hdr));
+    ring_buf_put(&trace_ring, data, len);
+    k_spin_unlock(&trace_lock, key);
+}
+
+void pdu_trace_rx(uint32_t opcode, const struct bt_mesh_msg_ctx *ctx,
+                  const struct net_buf_simple *buf)
+{
+    struct pdu_trace_hdr hdr = {
+        .ttl = ctx->recv_ttl,
+        .rssi = ctx->recv_rssi,
+        .src = sys_cpu_to_le16(ctx->addr),
+        .dst = sys_cpu_to_le16(ctx->recv_dst),
+        .opcode = sys_cpu_to_le32(opcode),
+    };
+
+    record(&hdr, buf->data, buf->len);
+}
+
+void pdu_trace_tx(uint32_t opcode, const struct bt_mesh_msg_ctx *ctx,
+                  const struct net_buf_simple *msg, int err)
+{
+    size_t op_len = MIN(opcode_len(opcode), msg->len);
+    struct pdu_trace_hdr hdr = {
+        .flags = PDU_TRACE_F_TX | (err ? PDU_TRACE_F_SEND_ERR : 0),
+        .ttl = ctx->send_ttl,
+        .src = sys_cpu_to_le16(BT_MESH_ADDR_UNASSIGNED),
+        .dst = sys_cpu_to_le16(ctx->addr),
+        .opcode = sys_cpu_to_le32(opcode),
+    };
+
+    record(&hdr, msg->data + op_len, msg->len - op_len);
+}
+
+static void trace_drain(struct k_work *work)
+{
+    uint8_t rec[RECORD_MAX];
+    struct pdu_trace_hdr *hdr = (struct pdu_trace_hdr *)rec;
+    k_spinlock_key_t key;
+    uint32_t gap_lost;
+    size_t size;
+
+    /* This work item is the only writer on the channel, so the RTT writes
+     * need no lock. Each record is copied out under trace_lock and written
+     * without it, keeping record() callers from spinning on the host.
+     */
+    for (;;) {
+        key = k_spin_lock(&trace_lock);
+        gap_lost = lost;
+        if (gap_lost) {
+            *hdr = (struct pdu_trace_hdr){
+                .flags = PDU_TRACE_F_GAP,
+                .opcode = sys_cpu_to_le32(gap_lost),
+                .timestamp_us = sys_cpu_to_le32(trace_time_us()),
+            };
+            size = sizeof(*hdr);
+        } else if (!ring_buf_is_empty(&trace_ring)) {
+            ring_buf_peek(&trace_ring, rec, sizeof(*hdr));
+            size = sizeof(*hdr) + hdr->len;
+            ring_buf_peek(&trace_ring, rec, size);
+        } else {
+            k_spin_unlock(&trace_lock, key);
+            break;
+        }
+        k_spin_unlock(&trace_lock, key);
+
+        /* The channel is in skip mode, so a record is either written whole
+         * or not at all and stays queued until the host catches up.
+         */
+        if (!SEGGER_RTT_WriteNoLock(RTT_CHANNEL, rec, size)) {
+            break;
+        }
+
+        key = k_spin_lock(&trace_lock);
+        if (gap_lost) {
+            /* Records lost meanwhile go into the next gap record */
+            lost -= gap_lost;
+        } else if (lost) {
+            /* The first record overwritten meanwhile was the one just
+             * written, which did reach the host.
+             */
+            lost--;
+        } else {
+            ring_buf_get(&trace_ring, NULL, size);
+        }
+        k_spin_unlock(&trace_lock, key);
+    }
+
+    k_work_schedule(&drain_work, K_MSEC(CONFIG_VENDOR_MODEL_TRACE_DRAIN_MS));
+}
+
+static int pdu_trace_init(void)
+{
+    SEGGER_RTT_ConfigUpBuffer(RTT_CHANNEL, "pdu_trace", rtt_buf,
+                              sizeof(rtt_buf), SEGGER_RTT_MODE_NO_BLOCK_SKIP);
+    k_work_schedule(&drain_work, K_MSEC(CONFIG_VENDOR_MODEL_TRACE_DRAIN_MS));
+
+    return 0;
+}
+
+SYS_INIT(pdu_trace_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
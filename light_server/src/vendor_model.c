@@ -1,25 +1,50 @@
+#include <zephyr/kernel.h>
 #include <zephyr/bluetooth/mesh.h>
 #include "vendor_model.h"
+#include "pdu_trace.h"
+#if defined(CONFIG_VENDOR_MODEL_NET_TIME)
+#include "net_time.h"
+#endif
 
 /* Forward declarations of message handlers */
 static int handle_led_set(const struct bt_mesh_model *model,
                         struct bt_mesh_msg_ctx *ctx,
                         struct net_buf_simple *buf);
+#if defined(CONFIG_VENDOR_MODEL_OP_LED_GET)
 static int handle_led_get(const struct bt_mesh_model *model,
                         struct bt_mesh_msg_ctx *ctx,
                         struct net_buf_simple *buf);
+#endif
 static int handle_led_status(const struct bt_mesh_model *model,
                            struct bt_mesh_msg_ctx *ctx,
                            struct net_buf_simple *buf);
+#if defined(CONFIG_VENDOR_MODEL_OP_BUTTON_PRESS)
 static int handle_button_press(const struct bt_mesh_model *model,
                              struct bt_mesh_msg_ctx *ctx,
                              struct net_buf_simple *buf);
+#endif
+#if defined(CONFIG_VENDOR_MODEL_NET_TIME)
+static int handle_time_beacon(const struct bt_mesh_model *model,
+                            struct bt_mesh_msg_ctx *ctx,
+                            struct net_buf_simple *buf);
+static int handle_led_set_at(const struct bt_mesh_model *model,
+                           struct bt_mesh_msg_ctx *ctx,
+                           struct net_buf_simple *buf);
+#endif
 
 /* Operation arrays for the models */
 const struct bt_mesh_model_op vendor_srv_op[] = {
     { BT_MESH_VENDOR_OP_LED_SET, 2, handle_led_set },
+#if defined(CONFIG_VENDOR_MODEL_OP_LED_GET)
     { BT_MESH_VENDOR_OP_LED_GET, 1, handle_led_get },
+#endif
+#if defined(CONFIG_VENDOR_MODEL_OP_BUTTON_PRESS)
     { BT_MESH_VENDOR_OP_BUTTON_PRESS, 2, handle_button_press },
+#endif
+#if defined(CONFIG_VENDOR_MODEL_NET_TIME)
+    { BT_MESH_VENDOR_OP_TIME_BEACON, 6, handle_time_beacon },
+    { BT_MESH_VENDOR_OP_LED_SET_AT, 6, handle_led_set_at },
+#endif
     BT_MESH_MODEL_OP_END,
 };
 
@@ -34,14 +59,20 @@ static int handle_led_set(const struct bt_mesh_model *model,
                         struct net_buf_simple *buf)
 {
     struct bt_mesh_vendor_model_srv *srv = model->user_data;
-    uint8_t led_index = net_buf_simple_pull_u8(buf);
-    uint8_t led_state = net_buf_simple_pull_u8(buf);
+    uint8_t led_index, led_state;
+
+    pdu_trace_rx(BT_MESH_VENDOR_OP_LED_SET, ctx, buf);
+    led_index = net_buf_simple_pull_u8(buf);
+    led_state = net_buf_simple_pull_u8(buf);
 
+    /* The handler owns the response and the stored state, so it can
+     * defer both until the LED has actually been switched.
+     */
     if (srv->handlers.led_set) {
         srv->handlers.led_set(srv, ctx, led_index, led_state);
+        return 0;
     }
 
-    /* Store the LED state */
     if (led_index < 4) {
         srv->led_states[led_index] = led_state;
     }
@@ -56,15 +87,20 @@ static int handle_led_set(const struct bt_mesh_model *model,
     return 0;
 }
 
+#if defined(CONFIG_VENDOR_MODEL_OP_LED_GET)
 static int handle_led_get(const struct bt_mesh_model *model,
                         struct bt_mesh_msg_ctx *ctx,
                         struct net_buf_simple *buf)
 {
     struct bt_mesh_vendor_model_srv *srv = model->user_data;
-    uint8_t led_index = net_buf_simple_pull_u8(buf);
+    uint8_t led_index;
+
+    pdu_trace_rx(BT_MESH_VENDOR_OP_LED_GET, ctx, buf);
+    led_index = net_buf_simple_pull_u8(buf);
 
     if (srv->handlers.led_get) {
         srv->handlers.led_get(srv, ctx, led_index);
+        return 0;
     }
 
     /* Send status message back */
@@ -76,6 +112,7 @@ static int handle_led_get(const struct bt_mesh_model *model,
     
     return 0;
 }
+#endif
 
 static int handle_led_status(const struct bt_mesh_model *model,
                            struct bt_mesh_msg_ctx *ctx,
@@ -84,6 +121,7 @@ static int handle_led_status(const struct bt_mesh_model *model,
     struct bt_mesh_vendor_model_cli *cli = model->user_data;
     struct led_status status;
 
+    pdu_trace_rx(BT_MESH_VENDOR_OP_LED_STATUS, ctx, buf);
     status.led_index = net_buf_simple_pull_u8(buf);
     status.led_state = net_buf_simple_pull_u8(buf);
 
@@ -94,6 +132,7 @@ static int handle_led_status(const struct bt_mesh_model *model,
     return 0;
 }
 
+#if defined(CONFIG_VENDOR_MODEL_OP_BUTTON_PRESS)
 static int handle_button_press(const struct bt_mesh_model *model,
                             struct bt_mesh_msg_ctx *ctx,
                             struct net_buf_simple *buf)
@@ -101,6 +140,7 @@ static int handle_button_press(const struct bt_mesh_model *model,
     struct bt_mesh_vendor_model_srv *srv = model->user_data;
     struct button_press press;
 
+    pdu_trace_rx(BT_MESH_VENDOR_OP_BUTTON_PRESS, ctx, buf);
     press.button_index = net_buf_simple_pull_u8(buf);
     press.button_state = net_buf_simple_pull_u8(buf);
 
@@ -110,6 +150,89 @@ static int handle_button_press(const struct bt_mesh_model *model,
     
     return 0;
 }
+#endif
+
+#if defined(CONFIG_VENDOR_MODEL_NET_TIME)
+static int handle_time_beacon(const struct bt_mesh_model *model,
+                            struct bt_mesh_msg_ctx *ctx,
+                            struct net_buf_simple *buf)
+{
+    /* Timestamp first, anything done before adds to the offset error */
+    uint32_t rx_us = net_time_local_us();
+    struct time_beacon beacon;
+
+    pdu_trace_rx(BT_MESH_VENDOR_OP_TIME_BEACON, ctx, buf);
+    beacon.seq = net_buf_simple_pull_u8(buf);
+    beacon.ttl = net_buf_simple_pull_u8(buf);
+    beacon.prev_tx_us = net_buf_simple_pull_le32(buf);
+
+    net_time_beacon_rx(ctx->addr, &beacon, ctx->recv_ttl, rx_us);
+
+    return 0;
+}
+
+static int handle_led_set_at(const struct bt_mesh_model *model,
+                           struct bt_mesh_msg_ctx *ctx,
+                           struct net_buf_simple *buf)
+{
+    struct bt_mesh_vendor_model_srv *srv = model->user_data;
+    uint8_t led_index, led_state;
+    uint32_t exec_at;
+    uint32_t delay_us = 0;
+    int err;
+
+    pdu_trace_rx(BT_MESH_VENDOR_OP_LED_SET_AT, ctx, buf);
+    led_index = net_buf_simple_pull_u8(buf);
+    led_state = net_buf_simple_pull_u8(buf);
+    exec_at = net_buf_simple_pull_le32(buf);
+
+    err = net_time_until(ctx->addr, exec_at, &delay_us);
+    if (err == -EAGAIN) {
+        /* Without a usable clock, execute right away rather than never */
+        delay_us = 0;
+    } else if (err) {
+        /* Stale, or so far ahead that the time is likely corrupt */
+        VENDOR_MODEL_PRINTK("LED Set At from 0x%04x %s, dropped\n", ctx->addr,
+                            err == -ETIME ? "too late" : "out of range");
+        return 0;
+    }
+
+    if (srv->handlers.led_set_at) {
+        srv->handlers.led_set_at(srv, ctx, led_index, led_state, delay_us);
+        return 0;
+    }
+
+    if (srv->handlers.led_set) {
+        srv->handlers.led_set(srv, ctx, led_index, led_state);
+        return 0;
+    }
+
+    if (led_index < 4) {
+        srv->led_states[led_index] = led_state;
+    }
+
+    struct led_status status = {
+        .led_index = led_index,
+        .led_state = led_state
+    };
+    bt_mesh_vendor_model_srv_led_status_send(srv, ctx, &status);
+
+    return 0;
+}
+#endif /* CONFIG_VENDOR_MODEL_NET_TIME */
+
+static int vendor_srv_init(const struct bt_mesh_model *model)
+{
+    struct bt_mesh_vendor_model_srv *srv = model->user_data;
+
+    srv->model = model;
+
+    return 0;
+}
+
+const struct bt_mesh_model_cb vendor_srv_cb = {
+    .init = vendor_srv_init,
+};
 
 /* Client API Implementation */
 int bt_mesh_vendor_model_cli_led_set(struct bt_mesh_vendor_model_cli *cli,
@@ -171,11 +294,17 @@ int bt_mesh_vendor_model_srv_led_status_send(struct bt_mesh_vendor_model_srv *sr
                                           struct bt_mesh_msg_ctx *ctx,
                                           struct led_status *status)
 {
-    struct net_buf_simple *msg = NET_BUF_SIMPLE(BT_MESH_VENDOR_MSG_MAXLEN_MESSAGE);
+    BT_MESH_MODEL_BUF_DEFINE(msg, BT_MESH_VENDOR_OP_LED_STATUS,
+                            BT_MESH_VENDOR_MSG_MAXLEN_MESSAGE);
 
-    net_buf_simple_init(msg, 0);
-    net_buf_simple_add_u8(msg, status->led_index);
-    net_buf_simple_add_u8(msg, status->led_state);
+    bt_mesh_model_msg_init(&msg, BT_MESH_VENDOR_OP_LED_STATUS);
+    net_buf_simple_add_u8(&msg, status->led_index);
+    net_buf_simple_add_u8(&msg, status->led_state);
+
+    int err = bt_mesh_model_send(srv->model, ctx, &msg, NULL, NULL);
+
+    vendor_model_send_count(err);
+    pdu_trace_tx(BT_MESH_VENDOR_OP_LED_STATUS, ctx, &msg, err);
 
-    return bt_mesh_model_send(srv->model, ctx, msg, NULL, NULL);
+    return err;
 }
@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: Apache-2.0
+"""Check a built zephyr.elf against the RAM/ROM budget of its role profile.
+
+ROM is every allocated section that has file contents (code, rodata and the
+initial image of data). RAM is every allocated writable section plus NOBITS
+sections such as bss and noinit.
+
+Budgets live next to the application in footprint_budget.json:
+
+    {
+        "full":  {"rom": 262144, "ram": 65536},
+        "relay": {"rom": 196608, "ram": 49152}
+    }
+
+A profile without an entry, or a missing budget file, fails the check. Run
+with --update to record the current usage as the budget for the profile,
+after a deliberate footprint change or when adding a profile.
+"""
+
+import argparse
+import json
+import sys
+
+from elftools.elf.constants import SH_FLAGS
+from elftools.elf.elffile import ELFFile
+
+
+def measure(elf_path):
+    rom = 0
+    ram = 0
+
+    with open(elf_path, 'rb') as f:
+        for section in ELFFile(f).iter_sections():
+            flags = section['sh_flags']
+            if not flags & SH_FLAGS.SHF_ALLOC:
+                continue
+
+            size = section['sh_size']
+            nobits = section['sh_type'] == 'SHT_NOBITS'
+
+            if not nobits:
+                rom += size
+            if nobits or flags & SH_FLAGS.SHF_WRITE:
+                ram += size
+
+    return rom, ram
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--elf', required=True, help='path to zephyr.elf')
+    parser.add_argument('--profile', required=True, help='role profile name')
+    parser.add_argument('--budget', required=True,
+                        help='path to footprint_budget.json')
+    parser.add_argument('--update', action='store_true',
+                        help='record the current usage as the budget')
+    args = parser.parse_args()
+
+    rom, ram = measure(args.elf)
+
+    try:
+        with open(args.budget) as f:
+            budgets = json.load(f)
+    except FileNotFoundError:
+        if not args.update:
+            print(f'error: budget file {args.budget} not found, '
+                  f'create it with --update')
+            return 1
+        budgets = {}
+
+    print(f'{args.profile}: ROM {rom} B, RAM {ram} B')
+
+    if args.update:
+        budgets[args.profile] = {'rom': rom, 'ram': ram}
+        with open(args.budget, 'w') as f:
+            json.dump(budgets, f, indent=4, sort_keys=True)
+            f.write('\n')
+        print(f'Budget for {args.profile} updated')
+        return 0
+
+    budget = budgets.get(args.profile)
+    if budget is None:
+        print(f'error: no budget recorded for {args.profile}, '
+              f'record one with --update')
+        return 1
+
+    failed = False
+    for name, used in (('rom', rom), ('ram', ram)):
+        limit = budget.get(name)
+        if limit is None:
+            continue
+        if used > limit:
+            print(f'error: {name.upper()} {used} B exceeds budget {limit} B '
+                  f'by {used - limit} B')
+            failed = True
+        else:
+            print(f'{name.upper()} {used}/{limit} B ({limit - used} B free)')
+
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
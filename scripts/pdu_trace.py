@@ -0,0 +1,165 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: Apache-2.0
+"""Decode and replay vendor model PDU traces captured from the light server.
+
+Capture the RTT trace channel of a node built with
+CONFIG_VENDOR_MODEL_TRACE=y, for example:
+
+    JLinkRTTLogger -Device NRF52840_XXAA -If SWD -Speed 4000 \\
+        -RTTChannel 1 trace.bin
+
+then:
+
+    pdu_trace.py decode trace.bin
+    pdu_trace.py replay trace.bin
+
+replay builds light_server/replay for native_sim with the trace embedded
+and runs it. The received messages go through vendor_srv_op at their
+recorded spacing, and the LED Status replies are checked against the
+recorded ones.
+"""
+
+import argparse
+import collections
+import os
+import struct
+import subprocess
+import sys
+
+# Layout of struct pdu_trace_hdr in light_server/include/pdu_trace.h
+HDR = struct.Struct('<BBBbHHII')
+
+F_TX = 0x01
+F_TRUNCATED = 0x02
+F_SEND_ERR = 0x04
+F_GAP = 0x08
+
+COMPANY_ID = 0x0059
+OPCODES = {
+    0x00: 'LED Set',
+    0x01: 'LED Get',
+    0x02: 'LED Status',
+    0x03: 'Button Press',
+    0x04: 'Time Beacon',
+    0x05: 'LED Set At',
+}
+
+REPLAY_APP = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                          '..', 'light_server', 'replay')
+
+
+class Record(collections.namedtuple('Record', 'flags ttl rssi src dst '
+                                    'opcode timestamp_us payload')):
+    @property
+    def tx(self):
+        return bool(self.flags & F_TX)
+
+    @property
+    def gap(self):
+        return bool(self.flags & F_GAP)
+
+
+def records(data):
+    off = 0
+    while off + HDR.size <= len(data):
+        (length, flags, ttl, rssi, src, dst, opcode,
+         timestamp_us) = HDR.unpack_from(data, off)
+        end = off + HDR.size + length
+        if end > len(data):
+            break
+        yield Record(flags, ttl, rssi, src, dst, opcode, timestamp_us,
+                     data[off + HDR.size:end])
+        off = end
+
+    if off != len(data):
+        print(f'warning: trace ends with a partial record '
+              f'({len(data) - off} bytes)', file=sys.stderr)
+
+
+def opcode_name(opcode):
+    if opcode >> 16 == 0 or opcode & 0xffff != COMPANY_ID:
+        return f'0x{opcode:06x}'
+    return OPCODES.get((opcode >> 16) & 0x3f, f'0x{opcode:06x}')
+
+
+def decode(args):
+    with open(args.trace, 'rb') as f:
+        data = f.read()
+
+    counts = collections.Counter()
+    lost = 0
+    base = None
+    elapsed = 0
+    last = 0
+
+    for rec in records(data):
+        if rec.gap:
+            print(f'{"":>12}  {rec.opcode} records lost')
+            lost += rec.opcode
+            continue
+
+        # Unwrap the 32-bit microsecond timestamps
+        if base is None:
+            base = rec.timestamp_us
+        else:
+            elapsed += (rec.timestamp_us - last) & 0xffffffff
+        last = rec.timestamp_us
+
+        name = opcode_name(rec.opcode)
+        counts[('TX' if rec.tx else 'RX', name)] += 1
+
+        if rec.tx:
+            line = f'TX          -> 0x{rec.dst:04x} ttl {rec.ttl:3}'
+        else:
+            line = (f'RX 0x{rec.src:04x} -> 0x{rec.dst:04x} ttl {rec.ttl:3} '
+                    f'rssi {rec.rssi:4}')
+        payload = rec.payload.hex(' ')
+        if rec.flags & F_TRUNCATED:
+            payload += ' ...'
+        if rec.flags & F_SEND_ERR:
+            payload += ' (send failed)'
+
+        print(f'{elapsed / 1e6:12.6f}  {line}  {name:<12} {payload}')
+
+    if args.summary:
+        print()
+        for (direction, name), count in sorted(counts.items()):
+            print(f'{direction} {name:<12} {count}')
+        print(f'Lost {lost}')
+
+    return 0
+
+
+def replay(args):
+    trace = os.path.abspath(args.trace)
+    build = ['west', 'build', '-b', 'native_sim', '-d', args.build_dir,
+             '-p', 'auto', REPLAY_APP, '--', f'-DPDU_TRACE={trace}']
+
+    subprocess.run(build, check=True)
+
+    return subprocess.run([os.path.join(args.build_dir, 'zephyr',
+                                        'zephyr.exe')]).returncode
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest='cmd', required=True)
+
+    p = sub.add_parser('decode', help='print the records of a trace')
+    p.add_argument('trace')
+    p.add_argument('--summary', action='store_true',
+                   help='also print message counts per opcode')
+    p.set_defaults(func=decode)
+
+    p = sub.add_parser('replay', help='replay a trace on native_sim')
+    p.add_argument('trace')
+    p.add_argument('--build-dir', default='build-replay')
+    p.set_defaults(func=replay)
+
+    args = parser.parse_args()
+    return args.func(args)
+
+
+if __name__ == '__main__':
+    sys.exit(main())